@@ -0,0 +1,53 @@
+#pragma once
+#include "video_decoder.h"
+#include <cstddef>
+#include <string>
+
+struct VideoCompareConfig
+{
+    std::string left_file_name;
+    std::string right_file_name;
+
+    // Decode forward from the preceding keyframe to the exact seek target
+    bool accurate_seek{false};
+
+    // Scan each input for keyframes in the background and cache the result
+    bool build_index{true};
+
+    // Index of the video stream compared in the left and right input (-1 =
+    // the best one); all other streams are discarded while demuxing
+    int video_stream[2]{-1, -1};
+
+    // Read local files through a memory mapping instead of read() calls
+    bool memory_map{false};
+
+    // Buffer read ahead of each demuxer by an I/O thread (0 = none)
+    size_t read_ahead_megabytes{0};
+
+    // Memory for the decoded frames kept for stepping back with A/D (both sides)
+    size_t history_megabytes{512};
+
+    // Memory the packet and frame queues of each side may hold
+    size_t packet_queue_megabytes{64};
+    size_t frame_queue_megabytes{512};
+
+    // Convert the displayed frames on the video thread straight into locked
+    // texture memory instead of on the decode threads into intermediate frames
+    bool direct_conversion{false};
+
+    // When zoomed out, convert frames at the displayed resolution (halving
+    // steps) instead of the full video size
+    bool display_resolution{false};
+
+    // When zoomed in, convert only the visible area (plus a margin for panning)
+    bool region_of_interest{true};
+
+    // Threads converting the slices of one frame (0 = half the cores)
+    size_t conversion_threads{0};
+
+    // Decoder threads of the left and right input (0 = the cores left over by
+    // the conversion threads, split by picture size)
+    size_t decoder_threads[2]{0, 0};
+
+    DecoderThreadType decoder_thread_type{DecoderThreadType::automatic};
+};
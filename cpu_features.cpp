@@ -0,0 +1,41 @@
+#include "cpu_features.h"
+
+namespace
+{
+CpuFeatures detect()
+{
+    CpuFeatures features;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512bw = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+
+    return features;
+}
+}
+
+const CpuFeatures &cpu_features()
+{
+    static const CpuFeatures features = detect();
+
+    return features;
+}
+
+std::string cpu_features_string()
+{
+    const CpuFeatures &features = cpu_features();
+    std::string result;
+
+    if (features.sse2)
+        result += "SSE2 ";
+    if (features.avx2)
+        result += "AVX2 ";
+    if (features.avx512bw)
+        result += "AVX-512BW ";
+
+    return result.empty() ? "none" : result.substr(0, result.size() - 1);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+// Instruction set extensions of the CPU we are running on. The program is
+// built for baseline x86-64; hot kernels are compiled per ISA in their own
+// translation units (*_sse2.cpp, *_avx2.cpp, *_avx512.cpp) and chosen at
+// startup from these flags.
+struct CpuFeatures
+{
+    bool sse2{false};
+    bool avx2{false};
+    bool avx512bw{false};
+};
+
+const CpuFeatures &cpu_features();
+
+// e.g. "SSE2 AVX2"
+std::string cpu_features_string();
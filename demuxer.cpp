@@ -1,14 +1,66 @@
 #include "demuxer.h"
 #include "ffmpeg.h"
 #include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Prefetched from where a seek landed
+const size_t Demuxer::seek_read_ahead_{16 * 1024 * 1024};
+
+Demuxer::Demuxer(
+	const std::string &file_name, const bool build_index, const int stream_index, const bool memory_map,
+	const size_t read_ahead) {
+	if (read_ahead > 0) {
+		read_ahead_ = std::make_unique<ReadAhead>(file_name, read_ahead);
+	} else if (memory_map) {
+		mapped_file_ = MappedFile::open(file_name);
+	}
+	if (mapped_file_ || read_ahead_) {
+		format_context_ = avformat_alloc_context();
+		if (!format_context_) {
+			throw ffmpeg::Error{"Couldn't allocate format context"};
+		}
+		if (mapped_file_) {
+			format_context_->pb = mapped_file_->io_context();
+			mapped_file_->advise_sequential();
+		} else {
+			format_context_->pb = read_ahead_->io_context();
+		}
+	}
 
-Demuxer::Demuxer(const std::string &file_name) {
 	ffmpeg::check(avformat_open_input(
 		&format_context_, file_name.c_str(), nullptr, nullptr));
 	ffmpeg::check(avformat_find_stream_info(
 		format_context_, nullptr));
-	video_stream_index_ = ffmpeg::check(av_find_best_stream(
-		format_context_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+
+	if (stream_index < 0) {
+		video_stream_index_ = ffmpeg::check(av_find_best_stream(
+			format_context_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+	} else if (stream_index >= static_cast<int>(format_context_->nb_streams) ||
+		format_context_->streams[stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+		avformat_close_input(&format_context_);
+		throw std::runtime_error{"Stream " + std::to_string(stream_index) + " of " + file_name + " is not a video stream"};
+	} else {
+		video_stream_index_ = stream_index;
+	}
+
+	// av_read_frame() then skips the packets of the other streams (audio
+	// tracks, subtitles, data) instead of reading and returning them
+	for (unsigned i = 0; i < format_context_->nb_streams; ++i) {
+		if (static_cast<int>(i) != video_stream_index_) {
+			format_context_->streams[i]->discard = AVDISCARD_ALL;
+		}
+	}
+
+	// Containers whose own seeking scans for timestamps land exactly on an
+	// indexed keyframe when seeking to its byte position instead
+	const int format_flags = format_context_->iformat->flags;
+	byte_seek_ = !(format_flags & AVFMT_NO_BYTE_SEEK) &&
+		(format_flags & (AVFMT_TS_DISCONT | AVFMT_GENERIC_INDEX));
+
+	if (build_index) {
+		index_ = std::make_unique<PacketIndex>(file_name, video_stream_index_);
+	}
 }
 
 Demuxer::~Demuxer() {
@@ -31,12 +83,42 @@ int64_t Demuxer::duration() const {
 	return format_context_->duration;
 }
 
+const ReadAhead* Demuxer::read_ahead() const {
+	return read_ahead_.get();
+}
+
 bool Demuxer::operator()(AVPacket &packet) {
 	return av_read_frame(format_context_, &packet) >= 0;
 }
 
 bool Demuxer::seek(const float position, const bool backward) {
+    if (!mapped_file_) {
+        return seek_stream(position, backward);
+    }
+
+    // no readahead for the index lookups of the seek itself, then prefetch
+    // where it landed and go back to sequential reading
+    mapped_file_->advise_random();
+    const bool seeked = seek_stream(position, backward);
+    mapped_file_->will_need(avio_tell(format_context_->pb), seek_read_ahead_);
+    mapped_file_->advise_sequential();
+
+    return seeked;
+}
+
+bool Demuxer::seek_stream(const float position, const bool backward) {
     int64_t seekTarget = int64_t(position * 1000000.0f);
 
+    // resolve the keyframe from the index once the background scan is done
+    PacketIndexEntry keyframe;
+    const int64_t streamTarget = av_rescale_q(seekTarget, AVRational{1, AV_TIME_BASE}, time_base());
+
+    if (index_ && (backward ? index_->keyframe_before(streamTarget, keyframe) : index_->keyframe_after(streamTarget, keyframe))) {
+        if (byte_seek_ && keyframe.pos >= 0) {
+            return av_seek_frame(format_context_, video_stream_index_, keyframe.pos, AVSEEK_FLAG_BYTE) >= 0;
+        }
+        return av_seek_frame(format_context_, video_stream_index_, PacketIndex::timestamp(keyframe), AVSEEK_FLAG_BACKWARD) >= 0;
+    }
+
     return av_seek_frame(format_context_, -1, seekTarget, backward ? AVSEEK_FLAG_BACKWARD : 0) >= 0;
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include "mapped_file.h"
+#include "packet_index.h"
+#include "read_ahead.h"
+#include <memory>
 #include <string>
 extern "C" {
 	#include "libavformat/avformat.h"
@@ -6,16 +10,33 @@ extern "C" {
 
 class Demuxer {
 public:
-	Demuxer(const std::string &file_name);
+	// A stream index of -1 selects the best video stream; all other streams
+	// are discarded by the demuxer. Local files can be read through a memory
+	// mapping instead of read() calls, or any input through a read-ahead
+	// buffer of the given size (0 = none).
+	Demuxer(const std::string &file_name, const bool build_index = true, const int stream_index = -1,
+		const bool memory_map = false, const size_t read_ahead = 0);
 	~Demuxer();
 	AVCodecParameters* video_codec_parameters();
 	int video_stream_index() const;
 	AVRational time_base() const;
 	int64_t duration() const;
+	// nullptr without read-ahead
+	const ReadAhead* read_ahead() const;
 	bool operator()(AVPacket &packet);
     bool seek(const float position, const bool backward);
 
 private:
+	bool seek_stream(const float position, const bool backward);
+
+	static const size_t seek_read_ahead_;
+
+	// Outlive the format context reading through them
+	std::unique_ptr<MappedFile> mapped_file_;
+	std::unique_ptr<ReadAhead> read_ahead_;
 	AVFormatContext* format_context_{};
 	int video_stream_index_{};
+	std::unique_ptr<PacketIndex> index_;
+	// Seek to indexed keyframes by byte position (MPEG-TS/PS, raw streams)
+	bool byte_seek_{false};
 };
@@ -0,0 +1,70 @@
+#include "difference.h"
+#include "cpu_features.h"
+
+namespace {
+const int amplification = 2;
+
+inline uint8_t amplified_difference(const uint8_t a, const uint8_t b) {
+	const int value = (a > b ? a - b : b - a) * amplification;
+
+	return value > 255 ? 255 : value;
+}
+
+struct Implementation {
+	DifferenceRowFunction function;
+	const char* name;
+};
+
+Implementation select_implementation() {
+#if defined(__x86_64__) || defined(__i386__)
+	const CpuFeatures &features = cpu_features();
+
+	if (features.avx512bw) {
+		return {difference_row_avx512, "AVX-512"};
+	}
+	if (features.avx2) {
+		return {difference_row_avx2, "AVX2"};
+	}
+	if (features.sse2) {
+		return {difference_row_sse2, "SSE2"};
+	}
+#endif
+	return {difference_row_scalar, "scalar"};
+}
+
+const Implementation& implementation() {
+	static const Implementation selected = select_implementation();
+
+	return selected;
+}
+}
+
+void difference_row_scalar(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		diff[i] = amplified_difference(left[i], right[i]);
+	}
+}
+
+DifferenceRowFunction difference_row() {
+	return implementation().function;
+}
+
+const char* difference_row_name() {
+	return implementation().name;
+}
+
+void difference(
+	const uint8_t* left, size_t left_pitch,
+	const uint8_t* right, size_t right_pitch,
+	uint8_t* diff, size_t diff_pitch,
+	size_t row_bytes, size_t rows) {
+	const DifferenceRowFunction row = difference_row();
+
+	for (size_t y = 0; y < rows; y++) {
+		row(left, right, diff, row_bytes);
+
+		left += left_pitch;
+		right += right_pitch;
+		diff += diff_pitch;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Absolute difference with saturating amplification, computed byte-wise:
+// diff = min(255, |left - right| * 2). Used for the subtraction mode.
+using DifferenceRowFunction = void (*)(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes);
+
+// Scalar reference implementation
+void difference_row_scalar(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes);
+
+// Per-ISA kernels (difference_sse2.cpp etc.), only called after a CPU check
+void difference_row_sse2(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes);
+void difference_row_avx2(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes);
+void difference_row_avx512(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes);
+
+// Best implementation for the CPU we are running on (picked once at startup)
+DifferenceRowFunction difference_row();
+const char* difference_row_name();
+
+void difference(
+	const uint8_t* left, size_t left_pitch,
+	const uint8_t* right, size_t right_pitch,
+	uint8_t* diff, size_t diff_pitch,
+	size_t row_bytes, size_t rows);
@@ -0,0 +1,20 @@
+// Compiled with -mavx2 (see makefile); only called after a CPU check
+#include "difference.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+void difference_row_avx2(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes) {
+	size_t i = 0;
+
+	for (; (i + 32) <= bytes; i += 32) {
+		const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+		const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+		const __m256i d = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(diff + i), _mm256_adds_epu8(d, d));
+	}
+
+	difference_row_sse2(left + i, right + i, diff + i, bytes - i);
+}
+#endif
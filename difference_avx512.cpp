@@ -0,0 +1,20 @@
+// Compiled with -mavx512f -mavx512bw (see makefile); only called after a CPU check
+#include "difference.h"
+
+#if defined(__AVX512BW__)
+#include <immintrin.h>
+
+void difference_row_avx512(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes) {
+	size_t i = 0;
+
+	for (; (i + 64) <= bytes; i += 64) {
+		const __m512i a = _mm512_loadu_si512(left + i);
+		const __m512i b = _mm512_loadu_si512(right + i);
+		const __m512i d = _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a));
+
+		_mm512_storeu_si512(diff + i, _mm512_adds_epu8(d, d));
+	}
+
+	difference_row_avx2(left + i, right + i, diff + i, bytes - i);
+}
+#endif
@@ -0,0 +1,22 @@
+// Compiled with -msse2 (see makefile); only called after a CPU check
+#include "difference.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+
+// |a - b| is the OR of both saturated subtractions; doubling with a
+// saturating add is the same as clamping (|a - b| * 2) to 255
+void difference_row_sse2(const uint8_t* left, const uint8_t* right, uint8_t* diff, size_t bytes) {
+	size_t i = 0;
+
+	for (; (i + 16) <= bytes; i += 16) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+		const __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(diff + i), _mm_adds_epu8(d, d));
+	}
+
+	difference_row_scalar(left + i, right + i, diff + i, bytes - i);
+}
+#endif
@@ -1,4 +1,7 @@
 #include "display.h"
+#include "difference.h"
+#include "stats.h"
+#include "thread_pool.h"
 #include <stdexcept>
 #include <string>
 #include <sstream>
@@ -20,19 +23,20 @@ inline T check_SDL(T value, const std::string& message)
 	}
 }
 
-inline int clampIntToByteRange(int value)
+static const SDL_Color textColor = { 255, 255, 255, 0 };
+
+// pictures without pixels are converted into RGB24 texture memory
+static uint32_t texture_format(const DisplayFrame& frame)
 {
-	return value > 255 ? 255 : value < 0 ? 0
-		: value;
+	return frame.planes[0] != nullptr ? frame.format : (uint32_t)SDL_PIXELFORMAT_RGB24;
 }
 
-inline uint8_t clampIntToByte(int value)
+static bool contains(const SDL_Rect& outer, const SDL_Rect& inner)
 {
-	return (uint8_t)clampIntToByteRange(value);
+	return inner.x >= outer.x && inner.y >= outer.y &&
+		inner.x + inner.w <= outer.x + outer.w && inner.y + inner.h <= outer.y + outer.h;
 }
 
-static const SDL_Color textColor = { 255, 255, 255, 0 };
-
 SDL::SDL()
 {
 	check_SDL(!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER), "SDL init");
@@ -48,7 +52,9 @@ Display::Display(
 	const unsigned width,
 	const unsigned height,
 	const std::string& left_file_name,
-	const std::string& right_file_name) :
+	const std::string& right_file_name,
+	ThreadPool* thread_pool) :
+	thread_pool_{ thread_pool },
 	video_width_{ (int)width },
 	video_height_{ (int)height }
 {
@@ -79,6 +85,10 @@ Display::Display(
 
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
 
+	// BT.601 up to 576 lines and BT.709 above, limited range; frames signalled
+	// otherwise are converted to RGB before they get here
+	SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_AUTOMATIC);
+
 	SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
 	SDL_RenderClear(renderer_);
 	SDL_RenderPresent(renderer_);
@@ -98,7 +108,15 @@ Display::Display(
 	big_font_ = check_SDL(TTF_OpenFont(font_filename.c_str(), 24 * font_scale), "font open");
 
 	SDL_RenderSetLogicalSize(renderer_, drawable_width_, drawable_height_);
-	texture_ = check_SDL(SDL_CreateTexture(
+	left_texture_ = check_SDL(SDL_CreateTexture(
+		renderer_, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
+		width, height),
+		"renderer");
+	right_texture_ = check_SDL(SDL_CreateTexture(
+		renderer_, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
+		width, height),
+		"renderer");
+	difference_texture_ = check_SDL(SDL_CreateTexture(
 		renderer_, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
 		width, height),
 		"renderer");
@@ -124,11 +142,16 @@ Display::Display(
 	mouse_y = window_height_ / 2;
 	left_button_down_ = false;
 	right_button_down_ = false;
+
+	viewport_.area = visible_area(source_area(get_zoom()));
+	viewport_.changed_at = std::chrono::steady_clock::now();
 }
 
 Display::~Display()
 {
-	SDL_DestroyTexture(texture_);
+	SDL_DestroyTexture(left_texture_);
+	SDL_DestroyTexture(right_texture_);
+	SDL_DestroyTexture(difference_texture_);
 	SDL_DestroyTexture(left_text_texture);
 	SDL_DestroyTexture(right_text_texture);
 
@@ -149,57 +172,206 @@ Display::~Display()
 void Display::update_difference(
 	std::array<uint8_t*, 3> planes_left, std::array<size_t, 3> pitches_left,
 	std::array<uint8_t*, 3> planes_right, std::array<size_t, 3> pitches_right,
-	int split_x)
+	const SDL_Rect& area)
 {
-	uint8_t* p_left_r = planes_left[0] + split_x * 3;
-	uint8_t* p_left_g = planes_left[0] + split_x * 3 + 1;
-	uint8_t* p_left_b = planes_left[0] + split_x * 3 + 2;
+	StageTimer timer(Stage::difference);
 
-	uint8_t* p_right_r = planes_right[0] + split_x * 3;
-	uint8_t* p_right_g = planes_right[0] + split_x * 3 + 1;
-	uint8_t* p_right_b = planes_right[0] + split_x * 3 + 2;
+	// vectorized kernel (SSE2/AVX2/AVX-512) chosen at startup
+	auto difference_rows = [&](const int first, const int last)
+	{
+		difference(
+			planes_left[0] + first * pitches_left[0] + area.x * 3, pitches_left[0],
+			planes_right[0] + first * pitches_right[0] + area.x * 3, pitches_right[0],
+			diff_planes_[0] + first * video_width_ * 3 + area.x * 3, video_width_ * 3,
+			area.w * 3, last - first);
+	};
+
+	// bands of at least 64 rows, the kernel is memory bound
+	const int bands = thread_pool_ != nullptr ?
+		std::max(1, std::min(static_cast<int>(thread_pool_->concurrency()), area.h / 64)) : 1;
+
+	if (bands == 1)
+	{
+		difference_rows(area.y, area.y + area.h);
+		return;
+	}
 
-	uint8_t* p_diff_r = diff_planes_[0] + split_x * 3;
-	uint8_t* p_diff_g = diff_planes_[0] + split_x * 3 + 1;
-	uint8_t* p_diff_b = diff_planes_[0] + split_x * 3 + 2;
+	const int band_height = (area.h + bands - 1) / bands;
 
-	const int amplification = 2;
+	thread_pool_->run(bands, [&](size_t band)
+	{
+		const int first = area.y + static_cast<int>(band) * band_height;
+
+		difference_rows(first, std::min(first + band_height, area.y + area.h));
+	});
+}
 
-	for (int y = 0; y < video_height_; y++)
+bool Display::needs_update(TextureContent& uploaded, const TextureContent& content)
+{
+	if (content.frame_id != 0 && content.frame_id == uploaded.frame_id && content.other_frame_id == uploaded.other_frame_id &&
+		content.width == uploaded.width && content.height == uploaded.height && contains(uploaded.area, content.area))
+		return false;
+
+	uploaded = content;
+	return true;
+}
+
+SDL_Rect Display::picture_area(const SDL_Rect& area, const int width, const int height, const bool outward)
+{
+	if (width == video_width_ && height == video_height_)
+		return area;
+
+	float scale_x = float(width) / video_width_;
+	float scale_y = float(height) / video_height_;
+	SDL_Rect result;
+
+	if (outward)
 	{
-		for (int x = 0; x < (video_width_ - split_x); x++)
-		{
-			int rgb1[3], rgb2[3], diff[3];
+		result.x = (int)std::floor(area.x * scale_x);
+		result.y = (int)std::floor(area.y * scale_y);
+		result.w = std::min((int)std::ceil((area.x + area.w) * scale_x), width) - result.x;
+		result.h = std::min((int)std::ceil((area.y + area.h) * scale_y), height) - result.y;
+	}
+	else
+	{
+		result.x = (int)std::round(area.x * scale_x);
+		result.y = (int)std::round(area.y * scale_y);
+		result.w = std::max(1, std::min((int)std::round((area.x + area.w) * scale_x), width) - result.x);
+		result.h = std::max(1, std::min((int)std::round((area.y + area.h) * scale_y), height) - result.y);
+	}
+
+	return result;
+}
+
+const Display::TextureContent& Display::content_of(const SDL_Texture* texture)
+{
+	if (texture == left_texture_)
+		return left_uploaded_;
+	if (texture == right_texture_)
+		return right_uploaded_;
+
+	return difference_uploaded_;
+}
+
+void Display::ensure_format(SDL_Texture*& texture, TextureContent& uploaded, const uint32_t format)
+{
+	Uint32 current_format;
+	check_SDL(!SDL_QueryTexture(texture, &current_format, NULL, NULL, NULL), "texture query");
+
+	if (current_format != format)
+	{
+		SDL_DestroyTexture(texture);
+		texture = check_SDL(SDL_CreateTexture(
+			renderer_, format, SDL_TEXTUREACCESS_STREAMING,
+			video_width_, video_height_),
+			"renderer");
+		uploaded = TextureContent{};
+	}
+}
 
-			rgb1[0] = p_left_r[x * 3];
-			rgb1[1] = p_left_g[x * 3];
-			rgb1[2] = p_left_b[x * 3];
+void Display::update_texture(SDL_Texture* texture, TextureContent& uploaded, const DisplayFrame& frame, const SDL_Rect& area, const std::string& name)
+{
+	const int width = frame.width > 0 ? frame.width : video_width_;
+	const int height = frame.height > 0 ? frame.height : video_height_;
 
-			rgb2[0] = p_right_r[x * 3];
-			rgb2[1] = p_right_g[x * 3];
-			rgb2[2] = p_right_b[x * 3];
+	if (frame.planes[0] == nullptr)
+	{
+		// converted straight into texture memory (locked contents are
+		// undefined, so always the whole picture)
+		SDL_Rect whole = { 0, 0, width, height };
 
-			diff[0] = abs(rgb1[0] - rgb2[0]) * amplification;
-			diff[1] = abs(rgb1[1] - rgb2[1]) * amplification;
-			diff[2] = abs(rgb1[2] - rgb2[2]) * amplification;
+		if (needs_update(uploaded, { frame.id, 0, width, height, whole }))
+		{
+			void* pixels;
+			int pitch;
 
-			p_diff_r[x * 3] = clampIntToByte(diff[0]);
-			p_diff_g[x * 3] = clampIntToByte(diff[1]);
-			p_diff_b[x * 3] = clampIntToByte(diff[2]);
+			check_SDL(!SDL_LockTexture(texture, &whole, &pixels, &pitch), name + " texture lock");
+			frame.convert(static_cast<uint8_t*>(pixels), pitch);
+			SDL_UnlockTexture(texture);
 		}
+	}
+	else if (frame.format == SDL_PIXELFORMAT_RGB24)
+	{
+		SDL_Rect rgb_area = picture_area(area, width, height, true);
 
-		p_left_r += pitches_left[0];
-		p_left_g += pitches_left[0];
-		p_left_b += pitches_left[0];
+		if (needs_update(uploaded, { frame.id, 0, width, height, rgb_area }))
+		{
+			check_SDL(!SDL_UpdateTexture(
+				texture, &rgb_area,
+				frame.planes[0] + rgb_area.y * frame.pitches[0] + rgb_area.x * 3, frame.pitches[0]),
+				name + " texture update (video mode)");
+		}
+	}
+	else
+	{
+		// 4:2:0 chroma needs even coordinates: the area is rounded out to
+		// whole chroma samples and clamped to the even-rounded-up video size
+		// (not the video size itself, which would leave an odd end when the
+		// width or height is odd); the planes hold the last, partial chroma
+		// sample, and SDL clips the rect to the texture
+		SDL_Rect chroma_area = { area.x & ~1, area.y & ~1, 0, 0 };
+		chroma_area.w = std::min((area.x + area.w + 1) & ~1, (video_width_ + 1) & ~1) - chroma_area.x;
+		chroma_area.h = std::min((area.y + area.h + 1) & ~1, (video_height_ + 1) & ~1) - chroma_area.y;
+
+		if (needs_update(uploaded, { frame.id, 0, width, height, chroma_area }))
+		{
+			const uint8_t* y = frame.planes[0] + chroma_area.y * frame.pitches[0] + chroma_area.x;
 
-		p_right_r += pitches_right[0];
-		p_right_g += pitches_right[0];
-		p_right_b += pitches_right[0];
+			if (frame.format == SDL_PIXELFORMAT_NV12)
+			{
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+				check_SDL(!SDL_UpdateNVTexture(
+					texture, &chroma_area,
+					y, frame.pitches[0],
+					frame.planes[1] + chroma_area.y / 2 * frame.pitches[1] + chroma_area.x, frame.pitches[1]),
+					name + " texture update (NV12)");
+#endif
+			}
+			else
+			{
+				check_SDL(!SDL_UpdateYUVTexture(
+					texture, &chroma_area,
+					y, frame.pitches[0],
+					frame.planes[1] + chroma_area.y / 2 * frame.pitches[1] + chroma_area.x / 2, frame.pitches[1],
+					frame.planes[2] + chroma_area.y / 2 * frame.pitches[2] + chroma_area.x / 2, frame.pitches[2]),
+					name + " texture update (IYUV)");
+			}
+		}
+	}
+}
+
+DisplayFrame Display::in_memory(const DisplayFrame& frame, const int side)
+{
+	if (frame.planes[0] != nullptr && frame.format == SDL_PIXELFORMAT_RGB24 &&
+		(frame.width == 0 || frame.width == video_width_) && (frame.height == 0 || frame.height == video_height_))
+		return frame;
+
+	const size_t pitch = video_width_ * 3;
 
-		p_diff_r += video_width_ * 3;
-		p_diff_g += video_width_ * 3;
-		p_diff_b += video_width_ * 3;
+	if (frame.id == 0 || frame.id != scratch_id_[side])
+	{
+		scratch_[side].resize(pitch * video_height_);
+		frame.convert(scratch_[side].data(), pitch);
+		scratch_id_[side] = frame.id;
 	}
+
+	DisplayFrame result = frame;
+	result.planes = { scratch_[side].data(), NULL, NULL };
+	result.pitches = { pitch, 0, 0 };
+	result.format = SDL_PIXELFORMAT_RGB24;
+	result.width = video_width_;
+	result.height = video_height_;
+	return result;
+}
+
+bool Display::Scene::operator==(const Scene& other) const
+{
+	return left_frame_id == other.left_frame_id && right_frame_id == other.right_frame_id &&
+		zoom == other.zoom && center_x == other.center_x && center_y == other.center_y &&
+		mouse_x == other.mouse_x && mouse_y == other.mouse_y &&
+		show_left == other.show_left && show_right == other.show_right && show_hud == other.show_hud &&
+		show_statistics == other.show_statistics && swap_left_right == other.swap_left_right && subtraction_mode == other.subtraction_mode &&
+		current_total_browsable == other.current_total_browsable && statistics == other.statistics;
 }
 
 float Display::get_zoom()
@@ -210,13 +382,43 @@ float Display::get_zoom()
 		return 1 / (1 - zoom_factor_);
 }
 
+SDL_Rect Display::source_area(const float zoom)
+{
+	int src_x_offset = std::min(std::max(0, (int)(window_center_pixel_x_ - window_width_ / zoom / 2)), video_width_);
+	int src_y_offset = std::min(std::max(0, (int)(window_center_pixel_y_ - window_height_ / zoom / 2)), video_height_);
+
+	return { src_x_offset, src_y_offset,
+		std::min((int)(window_center_pixel_x_ + window_width_ / zoom / 2), video_width_) - src_x_offset,
+		std::min((int)(window_center_pixel_y_ + window_height_ / zoom / 2), video_height_) - src_y_offset };
+}
+
+SDL_Rect Display::visible_area(const SDL_Rect& source_area)
+{
+	// the border keeps texture filtering at the edges from sampling stale texels
+	SDL_Rect area = { std::max(0, source_area.x - 1), std::max(0, source_area.y - 1), 0, 0 };
+	area.w = std::min(source_area.x + source_area.w + 1, video_width_) - area.x;
+	area.h = std::min(source_area.y + source_area.h + 1, video_height_) - area.y;
+
+	return area;
+}
+
+Viewport Display::get_viewport()
+{
+	std::lock_guard<std::mutex> lock(viewport_mutex_);
+	return viewport_;
+}
+
+float Display::get_resolution_scale()
+{
+	return subtraction_mode_ ? 1.0f : std::min(get_zoom(), 1.0f);
+}
+
 void Display::refresh(
-	std::array<uint8_t*, 3> planes_left, std::array<size_t, 3> pitches_left,
-	std::array<uint8_t*, 3> planes_right, std::array<size_t, 3> pitches_right,
-	const float left_position,
-	const float right_position,
+	const DisplayFrame& left,
+	const DisplayFrame& right,
 	const char* current_total_browsable,
-	const std::string& error_message)
+	const std::string& error_message,
+	const std::string& statistics)
 {
 	bool compare_mode = show_left_ && show_right_;
 	float zoom = get_zoom();
@@ -224,6 +426,20 @@ void Display::refresh(
 	int mouse_video_x = std::min(std::max(0, (int)std::round((mouse_x - window_width_ / 2) / zoom) + window_center_pixel_x_), video_width_);
 	int mouse_video_y = std::min(std::max(0, (int)std::round((mouse_y - window_height_ / 2) / zoom) + window_center_pixel_y_), video_height_);
 
+	// nothing to do while paused and idle (an error message still fading out
+	// keeps the picture animated)
+	Scene scene = { left.id, right.id, zoom, window_center_pixel_x_, window_center_pixel_y_, mouse_x, mouse_y,
+		show_left_, show_right_, show_hud_, show_statistics_, swap_left_right_, subtraction_mode_, current_total_browsable, statistics };
+
+	if (!redraw_ && left.id != 0 && right.id != 0 && scene == presented_ &&
+		error_message.empty() && error_message_texture == nullptr)
+	{
+		SDL_WaitEventTimeout(nullptr, idle_wait_ms_);
+		return;
+	}
+	presented_ = std::move(scene);
+	redraw_ = false;
+
 	// clear everything
 	SDL_RenderClear(renderer_);
 
@@ -231,42 +447,73 @@ void Display::refresh(
 	{
 		int split_x = compare_mode ? mouse_video_x : show_left_ ? video_width_ : 0;
 
-		// update video
-		if (show_left_ && (split_x > 0))
+		// visible source area
+		SDL_Rect src_zoomed_area = source_area(zoom);
+		SDL_Rect dst_zoomed_area = { std::min(std::max(0, (int)(window_width_ / 2 - (window_center_pixel_x_ - src_zoomed_area.x) * zoom)), window_width_),
+			std::min(std::max(0, (int)(window_height_ / 2 - (window_center_pixel_y_ - src_zoomed_area.y) * zoom)), window_height_),
+			std::min((int)(src_zoomed_area.w * zoom), window_width_), std::min((int)(src_zoomed_area.h * zoom), window_height_) };
+
+		// only what is visible gets computed and uploaded
+		SDL_Rect visible_area = this->visible_area(src_zoomed_area);
+
+		ensure_format(left_texture_, left_uploaded_, texture_format(left));
+		ensure_format(right_texture_, right_uploaded_, texture_format(right));
+
+		// textures shown left and right of the slider
+		SDL_Texture* left_side = nullptr;
+		SDL_Texture* right_side = nullptr;
+
+		if (show_left_)
+			left_side = swap_left_right_ ? right_texture_ : left_texture_;
+		if (show_right_)
+			right_side = subtraction_mode_ ? difference_texture_ : swap_left_right_ ? left_texture_ : right_texture_;
+
+		// update video (only new pictures or newly visible areas)
 		{
-			SDL_Rect render_quad_left = { 0, 0, split_x, video_height_ };
+			StageTimer timer(Stage::upload);
 
-			check_SDL(!SDL_UpdateTexture(texture_, &render_quad_left, planes_left[0], pitches_left[0]), "left texture update (video mode)");
+			if (left_side == left_texture_ || right_side == left_texture_)
+				update_texture(left_texture_, left_uploaded_, left, visible_area, "left");
+			if (left_side == right_texture_ || right_side == right_texture_)
+				update_texture(right_texture_, right_uploaded_, right, visible_area, "right");
 		}
-		if (show_right_ && (split_x < (video_width_ - 1)))
+		if (right_side == difference_texture_ && needs_update(difference_uploaded_, { left.id, right.id, video_width_, video_height_, visible_area }))
 		{
-			SDL_Rect render_quad_right = { split_x, 0, (video_width_ - split_x), video_height_ };
+			DisplayFrame left_pixels = in_memory(left, 0);
+			DisplayFrame right_pixels = in_memory(right, 1);
 
-			if (subtraction_mode_)
-			{
-				update_difference(planes_left, pitches_left, planes_right, pitches_right, split_x);
+			update_difference(left_pixels.planes, left_pixels.pitches, right_pixels.planes, right_pixels.pitches, visible_area);
 
-				check_SDL(!SDL_UpdateTexture(
-					texture_, &render_quad_right,
-					diff_planes_[0] + split_x * 3, video_width_ * 3),
-					"right texture update (subtraction mode)");
-			}
-			else
-			{
-				check_SDL(!SDL_UpdateTexture(texture_, &render_quad_right, planes_right[0] + split_x * 3, pitches_right[0]), "right texture update (video mode)");
-			}
+			check_SDL(!SDL_UpdateTexture(
+				difference_texture_, &visible_area,
+				diff_planes_[0] + visible_area.y * video_width_ * 3 + visible_area.x * 3, video_width_ * 3),
+				"difference texture update (subtraction mode)");
 		}
 
-		// render video
-		int src_x_offset = std::min(std::max(0, (int)(window_center_pixel_x_ - window_width_ / zoom / 2)), video_width_);
-		int src_y_offset = std::min(std::max(0, (int)(window_center_pixel_y_ - window_height_ / zoom / 2)), video_height_);
-		SDL_Rect src_zoomed_area = { src_x_offset, src_y_offset,
-			std::min((int)(window_center_pixel_x_ + window_width_ / zoom / 2), video_width_) - src_x_offset,
-			std::min((int)(window_center_pixel_y_ + window_height_ / zoom / 2), video_height_) - src_y_offset };
-		SDL_Rect dst_zoomed_area = { std::min(std::max(0, (int)(window_width_ / 2 - (window_center_pixel_x_ - src_zoomed_area.x) * zoom)), window_width_),
-			std::min(std::max(0, (int)(window_height_ / 2 - (window_center_pixel_y_ - src_zoomed_area.y) * zoom)), window_height_),
-			std::min((int)(src_zoomed_area.w * zoom), window_width_), std::min((int)(src_zoomed_area.h * zoom), window_height_) };
-		SDL_RenderCopy(renderer_, texture_, &src_zoomed_area, &dst_zoomed_area);
+		// render video: both sides are scaled identically and clipped at the slider
+		int split_dst_x = dst_zoomed_area.x + (int)std::round((split_x - src_zoomed_area.x) * zoom);
+		split_dst_x = std::min(std::max(dst_zoomed_area.x, split_dst_x), dst_zoomed_area.x + dst_zoomed_area.w);
+
+		SDL_Rect left_clip = { dst_zoomed_area.x, dst_zoomed_area.y, split_dst_x - dst_zoomed_area.x, dst_zoomed_area.h };
+		SDL_Rect right_clip = { split_dst_x, dst_zoomed_area.y, dst_zoomed_area.x + dst_zoomed_area.w - split_dst_x, dst_zoomed_area.h };
+
+		if (left_side != nullptr && left_clip.w > 0)
+		{
+			const TextureContent& content = content_of(left_side);
+			SDL_Rect src_area = picture_area(src_zoomed_area, content.width, content.height, false);
+
+			SDL_RenderSetClipRect(renderer_, &left_clip);
+			SDL_RenderCopy(renderer_, left_side, &src_area, &dst_zoomed_area);
+		}
+		if (right_side != nullptr && right_clip.w > 0)
+		{
+			const TextureContent& content = content_of(right_side);
+			SDL_Rect src_area = picture_area(src_zoomed_area, content.width, content.height, false);
+
+			SDL_RenderSetClipRect(renderer_, &right_clip);
+			SDL_RenderCopy(renderer_, right_side, &src_area, &dst_zoomed_area);
+		}
+		SDL_RenderSetClipRect(renderer_, NULL);
 	}
 
 	SDL_Rect fill_rect;
@@ -287,7 +534,7 @@ void Display::refresh(
 		if (show_left_)
 		{
 			// file name and current position of left video
-			sprintf(buffer, "%.2f", left_position);
+			sprintf(buffer, "%.2f", swap_left_right_ ? right.position : left.position);
 			textSurface = TTF_RenderText_Blended(small_font_, buffer, textColor);
 			SDL_Texture* left_position_text_texture = SDL_CreateTextureFromSurface(renderer_, textSurface);
 			int left_position_text_width = textSurface->w;
@@ -307,7 +554,7 @@ void Display::refresh(
 		if (show_right_)
 		{
 			// file name and current position of right video
-			sprintf(buffer, "%.2f", right_position);
+			sprintf(buffer, "%.2f", swap_left_right_ ? left.position : right.position);
 			textSurface = TTF_RenderText_Blended(small_font_, buffer, textColor);
 			SDL_Texture* right_position_text_texture = SDL_CreateTextureFromSurface(renderer_, textSurface);
 			int right_position_text_width = textSurface->w;
@@ -325,8 +572,8 @@ void Display::refresh(
 			SDL_DestroyTexture(right_position_text_texture);
 		}
 
-		char center_text[128];
-		sprintf(center_text, "%s  Zoom: %.2f", current_total_browsable, zoom);
+		char center_text[256];
+		snprintf(center_text, sizeof(center_text), "%s  Zoom: %.2f", current_total_browsable, zoom);
 
 		// current frame / no. in history buffer
 		textSurface = TTF_RenderText_Blended(small_font_, center_text, textColor);
@@ -342,9 +589,46 @@ void Display::refresh(
 		SDL_DestroyTexture(current_total_browsable_text_texture);
 	}
 
+	// pipeline statistics, one line each, bottom left
+	if (show_statistics_ && !statistics.empty())
+	{
+		std::vector<std::string> lines;
+		std::istringstream stream(statistics);
+
+		for (std::string line; std::getline(stream, line);)
+			lines.push_back(line);
+
+		int border_extension = 3 * font_scale;
+		int line_height = 20 * font_scale;
+		int y = drawable_height_ - 20 - (int)lines.size() * line_height;
+
+		SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 128);
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+
+		for (const std::string& line : lines)
+		{
+			textSurface = TTF_RenderText_Blended(small_font_, line.c_str(), textColor);
+			SDL_Texture* line_texture = SDL_CreateTextureFromSurface(renderer_, textSurface);
+			int line_width = textSurface->w;
+			int line_text_height = textSurface->h;
+			SDL_FreeSurface(textSurface);
+
+			fill_rect = { 20 - border_extension, y - border_extension, line_width + border_extension * 2, line_text_height + border_extension * 2 };
+			SDL_RenderFillRect(renderer_, &fill_rect);
+			text_rect = { 20, y, line_width, line_text_height };
+			SDL_RenderCopy(renderer_, line_texture, NULL, &text_rect);
+			SDL_DestroyTexture(line_texture);
+
+			y += line_height;
+		}
+	}
+
 	// render (optional) error message
 	if (!error_message.empty())
 	{
+		if (error_message_texture != nullptr)
+			SDL_DestroyTexture(error_message_texture);
+
 		error_message_shown_at = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
 		textSurface = TTF_RenderText_Blended(big_font_, error_message.c_str(), textColor);
 		error_message_texture = SDL_CreateTextureFromSurface(renderer_, textSurface);
@@ -364,6 +648,13 @@ void Display::refresh(
 		SDL_SetTextureAlphaMod(error_message_texture, 255 * keep_alpha);
 		text_rect = { drawable_width_ / 2 - error_message_width / 2, drawable_height_ / 2 - error_message_height / 2, error_message_width, error_message_height };
 		SDL_RenderCopy(renderer_, error_message_texture, NULL, &text_rect);
+
+		// fully faded out, so it no longer keeps the picture animated
+		if ((now - error_message_shown_at).count() >= 4000)
+		{
+			SDL_DestroyTexture(error_message_texture);
+			error_message_texture = nullptr;
+		}
 	}
 
 	if (show_hud_ && compare_mode)
@@ -376,6 +667,7 @@ void Display::refresh(
 		SDL_RenderDrawLine(renderer_, draw_x, 0, draw_x, drawable_height_);
 	}
 
+	StageTimer timer(Stage::present);
 	SDL_RenderPresent(renderer_);
 }
 
@@ -455,6 +747,9 @@ void Display::input()
 			case SDLK_3:
 				show_hud_ = !show_hud_;
 				break;
+			case SDLK_i:
+				show_statistics_ = !show_statistics_;
+				break;
 			case SDLK_0:
 				subtraction_mode_ = !subtraction_mode_;
 				break;
@@ -527,6 +822,10 @@ void Display::input()
 				break;
 			}
 			break;
+		case SDL_WINDOWEVENT:
+			// exposed or resized windows need the picture presented again
+			redraw_ = true;
+			break;
 		case SDL_QUIT:
 			quit_ = true;
 			break;
@@ -534,6 +833,21 @@ void Display::input()
 			break;
 		}
 	}
+
+	// publish what is visible for region-of-interest conversion
+	SDL_Rect area = visible_area(source_area(get_zoom()));
+	std::lock_guard<std::mutex> lock(viewport_mutex_);
+
+	if (!SDL_RectEquals(&area, &viewport_.area))
+	{
+		viewport_.area = area;
+		viewport_.changed_at = std::chrono::steady_clock::now();
+	}
+}
+
+bool Display::get_show_statistics()
+{
+	return show_statistics_;
 }
 
 bool Display::get_quit()
@@ -546,11 +860,6 @@ bool Display::get_play()
 	return play_;
 }
 
-bool Display::get_swap_left_right()
-{
-	return swap_left_right_;
-}
-
 float Display::get_seek_relative()
 {
 	return seek_relative_;
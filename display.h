@@ -2,9 +2,15 @@
 #include "SDL2/SDL.h"
 #include <SDL2/SDL_ttf.h>
 #include <array>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 #include <chrono>
+#include <mutex>
+
+class ThreadPool;
 
 struct SDL
 {
@@ -12,9 +18,39 @@ struct SDL
     ~SDL();
 };
 
+// One side's picture: pixels in an SDL pixel format (RGB24, or IYUV/NV12 for
+// 4:2:0 video converted by the renderer), and/or a function converting it
+// into the given RGB24 buffer, e.g. locked texture memory. Without pixels
+// (planes[0] null) the function is used to fill the texture.
+struct DisplayFrame
+{
+    std::array<uint8_t *, 3> planes{{nullptr, nullptr, nullptr}};
+    std::array<size_t, 3> pitches{{0, 0, 0}};
+    uint32_t format{SDL_PIXELFORMAT_RGB24};
+    std::function<void(uint8_t *, int)> convert;
+    // Size of the picture (0 means the video size; smaller when it was
+    // converted at the resolution actually displayed)
+    int width{0};
+    int height{0};
+    // Unique per picture (0 means unknown)
+    uint64_t id{0};
+    // Seconds
+    float position{0.0f};
+};
+
+// Source area visible on screen (video coordinates) and when it last
+// changed, as published for the decode threads
+struct Viewport
+{
+    SDL_Rect area;
+    std::chrono::steady_clock::time_point changed_at;
+};
+
 class Display
 {
 private:
+    // Splits the difference computation into bands of rows (optional)
+    ThreadPool *thread_pool_;
     int video_width_;
     int video_height_;
     int drawable_width_;
@@ -35,6 +71,7 @@ private:
     bool show_left_{true};
     bool show_right_{true};
     bool show_hud_{true};
+    bool show_statistics_{false};
     bool subtraction_mode_{false};
     float seek_relative_{0.0f};
     int frame_offset_delta_{0};
@@ -60,7 +97,61 @@ private:
 
     SDL_Window *window_;
     SDL_Renderer *renderer_;
-    SDL_Texture *texture_;
+    // One streaming texture per side (plus the difference), so moving the
+    // slider or swapping sides only changes how they are composited; a side's
+    // texture takes the pixel format of its pictures
+    SDL_Texture *left_texture_;
+    SDL_Texture *right_texture_;
+    SDL_Texture *difference_texture_;
+
+    // Which picture (and which area of it) a texture holds; the difference
+    // texture is made from two pictures
+    struct TextureContent
+    {
+        uint64_t frame_id{0};
+        uint64_t other_frame_id{0};
+        // Picture size within the texture
+        int width{0};
+        int height{0};
+        SDL_Rect area{0, 0, 0, 0};
+    };
+    TextureContent left_uploaded_;
+    TextureContent right_uploaded_;
+    TextureContent difference_uploaded_;
+
+    // Subtraction needs both pictures in memory, so pictures that only come
+    // as a conversion function are converted into these first
+    std::vector<uint8_t> scratch_[2];
+    uint64_t scratch_id_[2]{0, 0};
+
+    // Everything the last presented picture was made from; when none of it
+    // changed the renderer is left alone and refresh() waits for input instead
+    struct Scene
+    {
+        uint64_t left_frame_id{0};
+        uint64_t right_frame_id{0};
+        float zoom{0.0f};
+        int center_x{0};
+        int center_y{0};
+        int mouse_x{0};
+        int mouse_y{0};
+        bool show_left{false};
+        bool show_right{false};
+        bool show_hud{false};
+        bool show_statistics{false};
+        bool swap_left_right{false};
+        bool subtraction_mode{false};
+        std::string current_total_browsable;
+        std::string statistics;
+
+        bool operator==(const Scene &other) const;
+    };
+    Scene presented_;
+    bool redraw_{true};
+    static const int idle_wait_ms_{10};
+
+    std::mutex viewport_mutex_;
+    Viewport viewport_;
 
     SDL_Event event_;
     bool left_button_down_;
@@ -76,29 +167,47 @@ private:
     void update_difference(
         std::array<uint8_t *, 3> planes_left, std::array<size_t, 3> pitches_left,
         std::array<uint8_t *, 3> planes_right, std::array<size_t, 3> pitches_right,
-        int split_x);
+        const SDL_Rect &area);
 
-    float get_zoom();
+    // Records the content about to be uploaded, false if the texture already holds it
+    bool needs_update(TextureContent &uploaded, const TextureContent &content);
+    void ensure_format(SDL_Texture *&texture, TextureContent &uploaded, const uint32_t format);
+    void update_texture(SDL_Texture *texture, TextureContent &uploaded, const DisplayFrame &frame, const SDL_Rect &area, const std::string &name);
+    DisplayFrame in_memory(const DisplayFrame &frame, const int side);
+    // Maps video coordinates to the coordinates of a (smaller) picture
+    SDL_Rect picture_area(const SDL_Rect &area, const int width, const int height, const bool outward);
+    const TextureContent &content_of(const SDL_Texture *texture);
+    // Source area shown at the current zoom and pan, and the same with a one
+    // pixel border (what gets uploaded)
+    SDL_Rect source_area(const float zoom);
+    SDL_Rect visible_area(const SDL_Rect &source_area);
 
 public:
-    Display(const unsigned width, const unsigned height, const std::string &left_file_name, const std::string &right_file_name);
+    Display(const unsigned width, const unsigned height, const std::string &left_file_name, const std::string &right_file_name, ThreadPool *thread_pool = nullptr);
     ~Display();
 
     // Copy frame to display
     void refresh(
-        std::array<uint8_t *, 3> planes_left, std::array<size_t, 3> pitches_left,
-        std::array<uint8_t *, 3> planes_right, std::array<size_t, 3> pitches_right,
-        const float left_position,
-        const float right_position,
+        const DisplayFrame &left,
+        const DisplayFrame &right,
         const char *current_total_browsable,
-        const std::string &error_message);
+        const std::string &error_message,
+        const std::string &statistics = "");
 
     // Handle events
     void input();
 
+    float get_zoom();
+    // Fraction of the video resolution that ends up on screen (at most 1;
+    // subtraction compares at full resolution)
+    float get_resolution_scale();
+    // Thread safe, updated by input()
+    Viewport get_viewport();
+
+    // Pipeline statistics overlay (I key)
+    bool get_show_statistics();
     bool get_quit();
     bool get_play();
-    bool get_swap_left_right();
     float get_seek_relative();
     bool get_seek_from_start();
     int get_frame_offset_delta();
@@ -1,19 +1,50 @@
 #include "format_converter.h"
+#include "ffmpeg.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include <algorithm>
 #include <iostream>
 
 FormatConverter::FormatConverter(
 	size_t src_width, size_t src_height,
 	size_t dest_width, size_t dest_height,
-	AVPixelFormat input_pixel_format, AVPixelFormat output_pixel_format) :
+	AVPixelFormat input_pixel_format, AVPixelFormat output_pixel_format,
+	ThreadPool* thread_pool, bool use_kernels) :
 	src_width_{src_width}, src_height_{src_height}, 
 	dest_width_{dest_width}, dest_height_{dest_height},
-	output_pixel_format_{output_pixel_format}, conversion_context_{sws_getContext(
+	input_pixel_format_{input_pixel_format}, output_pixel_format_{output_pixel_format}, conversion_context_{sws_getContext(
 		// Source
 		src_width, src_height, input_pixel_format,
 		// Destination
 		dest_width, dest_height, output_pixel_format,
 		// Filters
-		SWS_BICUBIC, nullptr, nullptr, nullptr)} {
+		SWS_BICUBIC, nullptr, nullptr, nullptr)},
+	thread_pool_{thread_pool},
+	fast_row_{use_kernels ?
+		yuv_to_rgb_row(input_pixel_format, output_pixel_format, src_width != dest_width || src_height != dest_height) : nullptr} {
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+	if (fast_row_ == nullptr && thread_pool_ != nullptr && thread_pool_->concurrency() > 1) {
+		slice_contexts_.resize(thread_pool_->concurrency(), nullptr);
+
+		for (auto& context : slice_contexts_) {
+			context = sws_getContext(
+				// Source
+				src_width, src_height, input_pixel_format,
+				// Destination
+				dest_width, dest_height, output_pixel_format,
+				// Filters
+				SWS_BICUBIC, nullptr, nullptr, nullptr);
+		}
+	}
+#endif
+}
+
+FormatConverter::~FormatConverter() {
+	for (auto context : slice_contexts_) {
+		sws_freeContext(context);
+	}
+	sws_freeContext(region_context_);
+	sws_freeContext(conversion_context_);
 }
 
 size_t FormatConverter::src_width() const {
@@ -36,10 +67,192 @@ AVPixelFormat FormatConverter::output_pixel_format() const {
 	return output_pixel_format_;
 }
 
+void FormatConverter::convert_rows(
+	const AVFrame* src, uint8_t* dst, int dst_linesize, int x, int y, int width, int height) {
+	const YuvToRgbCoefficients coefficients = yuv_to_rgb_coefficients(
+		yuv_matrix(src->colorspace, src_height_), src->color_range == AVCOL_RANGE_JPEG);
+	const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(input_pixel_format_);
+	const AVComponentDescriptor& luma = descriptor->comp[0];
+	const AVComponentDescriptor& cb = descriptor->comp[1];
+	const AVComponentDescriptor& cr = descriptor->comp[2];
+
+	// 4:2:0, and x is even
+	auto convert = [&](const int first, const int last) {
+		for (int row = first; row < last; ++row) {
+			const int chroma_row = row >> 1;
+
+			fast_row_(
+				src->data[luma.plane] + row * src->linesize[luma.plane] + x * luma.step + luma.offset,
+				src->data[cb.plane] + chroma_row * src->linesize[cb.plane] + (x >> 1) * cb.step + cb.offset,
+				src->data[cr.plane] + chroma_row * src->linesize[cr.plane] + (x >> 1) * cr.step + cr.offset,
+				dst + row * dst_linesize + x * 3, width, coefficients);
+		}
+	};
+
+	// bands of at least 16 rows, so small regions stay on the calling thread
+	const int bands = thread_pool_ != nullptr ?
+		std::max(1, std::min(static_cast<int>(thread_pool_->concurrency()), height / 16)) : 1;
+
+	if (bands == 1) {
+		convert(y, y + height);
+		return;
+	}
+
+	const int band_height = (height + bands - 1) / bands;
+
+	thread_pool_->run(bands, [&](size_t band) {
+		const int first = y + static_cast<int>(band) * band_height;
+
+		convert(first, std::min(first + band_height, y + height));
+	});
+}
+
+void FormatConverter::set_colorspace(SwsContext* context) const {
+	const int* coefficients = sws_getCoefficients(sws_colorspace(matrix_));
+
+	// fails (and changes nothing) for RGB sources
+	sws_setColorspaceDetails(context, coefficients, full_range_, coefficients, 1, 0, 1 << 16, 1 << 16);
+}
+
+bool FormatConverter::update_colorspace(const AVFrame* src) {
+	const YuvMatrix matrix = yuv_matrix(src->colorspace, src_height_);
+	const bool full_range = src->color_range == AVCOL_RANGE_JPEG;
+
+	if (colorspace_set_ && matrix == matrix_ && full_range == full_range_) {
+		return false;
+	}
+
+	matrix_ = matrix;
+	full_range_ = full_range;
+	colorspace_set_ = true;
+
+	set_colorspace(conversion_context_);
+
+	for (auto context : slice_contexts_) {
+		set_colorspace(context);
+	}
+
+	return true;
+}
+
 void FormatConverter::operator()(AVFrame* src, AVFrame* dst) {
+	StageTimer timer(Stage::conversion, current_side());
+	timer.set_pts(src->pts);
+
+	if (fast_row_ != nullptr) {
+		convert_rows(src, dst->data[0], dst->linesize[0], 0, 0, src_width_, src_height_);
+		return;
+	}
+
+	update_colorspace(src);
+
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+	// the frame API needs reference counted pictures on both ends; each
+	// sws_frame_start() references them anew, so every slice of every frame
+	// allocates AVBufferRefs (released again by sws_frame_end())
+	if (!slice_contexts_.empty() && src->buf[0] != nullptr && dst->buf[0] != nullptr) {
+		const size_t alignment = sws_receive_slice_alignment(slice_contexts_[0]);
+		const size_t rows = (dest_height_ + slice_contexts_.size() - 1) / slice_contexts_.size();
+		const size_t slice_height = (rows + alignment - 1) / alignment * alignment;
+		const size_t slices = std::min(slice_contexts_.size(), (dest_height_ + slice_height - 1) / slice_height);
+
+		thread_pool_->run(slices, [&](size_t slice) {
+			SwsContext* context = slice_contexts_[slice];
+			const size_t start = slice * slice_height;
+
+			ffmpeg::check(sws_frame_start(context, dst, src));
+			ffmpeg::check(sws_send_slice(context, 0, src_height_));
+			ffmpeg::check(sws_receive_slice(context, start, std::min(slice_height, dest_height_ - start)));
+			sws_frame_end(context);
+		});
+		return;
+	}
+#endif
+
 	sws_scale(conversion_context_,
 		// Source
 		src->data, src->linesize, 0, src_height_,
 		// Destination
 		dst->data, dst->linesize);	
 }
+
+void FormatConverter::operator()(AVFrame* src, uint8_t* dst, int dst_linesize) {
+	StageTimer timer(Stage::conversion, current_side());
+	timer.set_pts(src->pts);
+
+	if (fast_row_ != nullptr) {
+		convert_rows(src, dst, dst_linesize, 0, 0, src_width_, src_height_);
+		return;
+	}
+
+	update_colorspace(src);
+
+	uint8_t* dst_data[4] = {dst, nullptr, nullptr, nullptr};
+	int dst_linesizes[4] = {dst_linesize, 0, 0, 0};
+
+	sws_scale(conversion_context_,
+		// Source
+		src->data, src->linesize, 0, src_height_,
+		// Destination
+		dst_data, dst_linesizes);
+}
+
+// Plane pointers of a picture starting at (x, y), like av_frame_apply_cropping()
+static void offset_planes(
+	const AVPixelFormat format, uint8_t* const data[], const int linesize[], int x, int y, uint8_t* offset_data[4]) {
+	const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(format);
+
+	for (int i = 0; i < 4; ++i) {
+		offset_data[i] = data[i];
+	}
+
+	for (int i = 0; i < descriptor->nb_components; ++i) {
+		const AVComponentDescriptor& component = descriptor->comp[i];
+		const bool chroma = (i == 1 || i == 2) && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB);
+		const int shift_x = chroma ? descriptor->log2_chroma_w : 0;
+		const int shift_y = chroma ? descriptor->log2_chroma_h : 0;
+
+		offset_data[component.plane] = data[component.plane] +
+			(y >> shift_y) * linesize[component.plane] + (x >> shift_x) * component.step;
+	}
+}
+
+void FormatConverter::operator()(AVFrame* src, AVFrame* dst, int x, int y, int width, int height) {
+	StageTimer timer(Stage::conversion, current_side());
+	timer.set_pts(src->pts);
+
+	if (fast_row_ != nullptr) {
+		convert_rows(src, dst->data[0], dst->linesize[0], x, y, width, height);
+		return;
+	}
+
+	const bool colorspace_changed = update_colorspace(src);
+
+	// a cached context is recreated, with default colorspace details,
+	// whenever the size changes
+	if (region_context_ == nullptr || width != region_width_ || height != region_height_) {
+		region_context_ = sws_getCachedContext(region_context_,
+			// Source
+			width, height, input_pixel_format_,
+			// Destination
+			width, height, output_pixel_format_,
+			// Filters
+			SWS_BICUBIC, nullptr, nullptr, nullptr);
+		region_width_ = width;
+		region_height_ = height;
+		set_colorspace(region_context_);
+	} else if (colorspace_changed) {
+		set_colorspace(region_context_);
+	}
+
+	uint8_t* src_data[4];
+	uint8_t* dst_data[4];
+	offset_planes(input_pixel_format_, src->data, src->linesize, x, y, src_data);
+	offset_planes(output_pixel_format_, dst->data, dst->linesize, x, y, dst_data);
+
+	sws_scale(region_context_,
+		// Source
+		src_data, src->linesize, 0, height,
+		// Destination
+		dst_data, dst->linesize);
+}
@@ -1,26 +1,67 @@
 #pragma once
+#include "yuv_to_rgb.h"
+#include <vector>
 extern "C" {
 	#include "libavformat/avformat.h"
+	#include "libavutil/pixdesc.h"
 	#include "libswscale/swscale.h"
 }
 
+class ThreadPool;
+
+// Whole frame conversions are split into horizontal slices run on a thread
+// pool when libswscale has the slice API (FFmpeg 5.0+): one SwsContext per
+// slice, each producing its band of output rows from the whole source, so
+// the result is identical to a single sws_scale() call. This path is not
+// allocation free: sws_frame_start() takes references to both frames in every
+// slice context, allocating a few small AVBufferRefs per slice and frame.
+//
+// Same-size conversions of the common 4:2:0 formats to RGB24 skip swscale and
+// use the kernels of yuv_to_rgb.h, in bands of rows on the same pool, unless
+// the caller asks for swscale only (the kernels take chroma from the nearest
+// sample where swscale interpolates). Both paths honor the colorspace and range
+// signalled by the source frame.
 class FormatConverter {
 public:
 	FormatConverter(
 		size_t src_width, size_t src_height,
 		size_t dest_width, size_t dest_height,
-		AVPixelFormat input_pixel_format, AVPixelFormat output_pixel_format);
+		AVPixelFormat input_pixel_format, AVPixelFormat output_pixel_format,
+		ThreadPool* thread_pool = nullptr, bool use_kernels = true);
+	~FormatConverter();
 	size_t src_width() const;
 	size_t src_height() const;
 	size_t dest_width() const;
 	size_t dest_height() const;
 	AVPixelFormat output_pixel_format() const;
 	void operator()(AVFrame* src, AVFrame* dst);
+	// Packed output straight into caller provided memory
+	void operator()(AVFrame* src, uint8_t* dst, int dst_linesize);
+	// Only a rectangle of the picture, unscaled, into the same place of dst
+	// (the position has to be aligned to the chroma subsampling)
+	void operator()(AVFrame* src, AVFrame* dst, int x, int y, int width, int height);
 private:
+	void convert_rows(const AVFrame* src, uint8_t* dst, int dst_linesize, int x, int y, int width, int height);
+	void set_colorspace(SwsContext* context) const;
+	// Whether the colorspace changed (and was set on the full size contexts)
+	bool update_colorspace(const AVFrame* src);
+
 	size_t src_width_;
 	size_t src_height_;
 	size_t dest_width_;
 	size_t dest_height_;
+	AVPixelFormat input_pixel_format_;
 	AVPixelFormat output_pixel_format_;
 	SwsContext* conversion_context_{};
+	// Follows the size of the requested rectangle
+	SwsContext* region_context_{};
+	int region_width_{0};
+	int region_height_{0};
+	ThreadPool* thread_pool_;
+	std::vector<SwsContext*> slice_contexts_;
+	YuvToRgbRowFunction fast_row_;
+	// Of the source, as last given to swscale
+	YuvMatrix matrix_{YuvMatrix::bt601};
+	bool full_range_{false};
+	bool colorspace_set_{false};
 };
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+extern "C" {
+	#include "libavcodec/avcodec.h"
+}
+
+// A rectangle of a picture in video coordinates (empty = all of it)
+struct Region {
+	int x{0};
+	int y{0};
+	int width{0};
+	int height{0};
+};
+
+// A picture on its way from a decode thread to the display: the decoder's
+// native frame (reference counted, e.g. 4:2:0 at 12 bpp) and, when it has
+// been made, its RGB24 conversion. The history buffer only keeps the native
+// frame and converts again when an older picture is displayed.
+struct Frame {
+	std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> decoded;
+	std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> converted;
+	// Part of the picture converted when zoomed in
+	Region converted_region;
+	int64_t pts{0};
+	// Unique per picture and side (0 = none), so the display can tell
+	// whether it already shows it
+	uint64_t id{0};
+
+	// Memory held by the native frame
+	size_t bytes() const {
+		return buffer_bytes(decoded.get());
+	}
+
+	// Memory held by both pictures (while queued)
+	size_t queued_bytes() const {
+		return bytes() + buffer_bytes(converted.get());
+	}
+
+	static size_t buffer_bytes(const AVFrame* frame) {
+		size_t total = 0;
+
+		if (frame != nullptr) {
+			for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i] != nullptr; ++i) {
+				total += frame->buf[i]->size;
+			}
+		}
+
+		return total;
+	}
+};
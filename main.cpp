@@ -1,10 +1,15 @@
 #define SDL_MAIN_HANDLED
 #include "video_compare.h"
 #include "argagg.h"
+#include "cpu_features.h"
+#include "difference.h"
+#include "trace.h"
+#include "yuv_to_rgb.h"
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <algorithm>
+#include <memory>
 #include <regex>
 #include <vector>
 
@@ -12,14 +17,36 @@ int main(int argc, char **argv)
 {
     try
     {
-        argagg::parser argparser{{{"help", {"-h", "--help"}, "show help", 0}}};
+        argagg::parser argparser{{{"help", {"-h", "--help"}, "show help", 0},
+                                   {"cpu-features", {"--cpu-features"}, "show the detected CPU features and the active kernel implementations, then exit", 0},
+                                   {"accurate-seek", {"-a", "--accurate-seek"}, "seek to the exact requested time stamp by decoding forward from the preceding keyframe (slower)", 0},
+                                   {"no-index", {"--no-index"}, "do not build or use the cached keyframe index (<file>.vcidx)", 0},
+                                   {"mmap", {"--mmap"}, "read local files through a memory mapping instead of read() calls (not on Windows)", 0},
+                                   {"read-ahead-mb", {"--read-ahead-mb"}, "read each input ahead on an I/O thread into a buffer of this many MB, e.g. 64 for network storage (default: off)", 1},
+                                   {"video-stream", {"--video-stream"}, "index of the video stream to compare, N or LEFT,RIGHT (default: the best video stream of each input)", 1},
+                                   {"history-mb", {"-m", "--history-mb"}, "memory budget in MB for decoded frames kept for stepping back with A/D (default: 512)", 1},
+                                   {"packet-queue-mb", {"--packet-queue-mb"}, "memory budget in MB for the queued packets of each input (default: 64)", 1},
+                                   {"frame-queue-mb", {"--frame-queue-mb"}, "memory budget in MB for the queued decoded frames of each input (default: 512)", 1},
+                                   {"direct-conversion", {"--direct-conversion"}, "convert displayed frames straight into texture memory, saving a full-frame copy per side (conversion moves to the video thread)", 0},
+                                   {"display-resolution", {"--display-resolution"}, "when zoomed out, convert frames at the displayed resolution instead of the full video size", 0},
+                                   {"no-roi", {"--no-roi"}, "always convert whole frames, also when zoomed in on a small area", 0},
+                                   {"conversion-threads", {"--conversion-threads"}, "number of threads converting the slices of one frame (default: half the CPU cores, 1 disables slicing)", 1},
+                                   {"decoder-threads", {"--decoder-threads"}, "decoder threads per input, N or LEFT,RIGHT (default: the cores not used for conversion, split by picture size)", 1},
+                                   {"decoder-thread-type", {"--decoder-thread-type"}, "decoder threading: frame, slice or auto (default: auto, frame threading where the codec supports it)", 1},
+                                   {"trace", {"--trace"}, "record pipeline events and write them to this file on exit, in Chrome Trace Event Format (for Perfetto)", 1}}};
 
         argagg::parser_results args;
         args = argparser.parse(argc, argv);
 
         std::tuple<int, int> window_size(-1, -1);
 
-        if (args["help"] || args.count() == 0)
+        if (args["cpu-features"])
+        {
+            std::cout << "CPU features: " << cpu_features_string() << std::endl
+                      << "Difference kernel: " << difference_row_name() << std::endl
+                      << "YUV to RGB kernel: " << yuv_to_rgb_row_name() << std::endl;
+        }
+        else if (args["help"] || args.count() == 0)
         {
             std::ostringstream usage;
             usage
@@ -37,7 +64,130 @@ int main(int argc, char **argv)
                 throw std::logic_error{"Two FFmpeg compatible video files must be supplied"};
             }
 
-            VideoCompare compare{args.pos[0], args.pos[1]};
+            VideoCompareConfig config;
+            config.left_file_name = args.pos[0];
+            config.right_file_name = args.pos[1];
+            config.accurate_seek = args["accurate-seek"];
+            config.build_index = !args["no-index"];
+            config.memory_map = args["mmap"];
+            config.direct_conversion = args["direct-conversion"];
+            config.display_resolution = args["display-resolution"];
+            config.region_of_interest = !args["no-roi"];
+
+            if (args["video-stream"])
+            {
+                const std::string video_stream = args["video-stream"].as<std::string>();
+                const std::regex video_stream_re("^([0-9]+)(?:,([0-9]+))?$");
+                std::smatch match;
+
+                if (!std::regex_match(video_stream, match, video_stream_re))
+                {
+                    throw std::logic_error{"Cannot parse video stream argument (must be N or LEFT,RIGHT)"};
+                }
+                config.video_stream[0] = std::stoi(match[1]);
+                config.video_stream[1] = match[2].matched ? std::stoi(match[2]) : config.video_stream[0];
+            }
+
+            if (args["read-ahead-mb"])
+            {
+                const int read_ahead_megabytes = args["read-ahead-mb"].as<int>();
+
+                if (read_ahead_megabytes <= 0)
+                {
+                    throw std::logic_error{"Read-ahead buffer must be a positive number of megabytes"};
+                }
+                if (config.memory_map)
+                {
+                    throw std::logic_error{"Memory mapping and read-ahead cannot be combined"};
+                }
+                config.read_ahead_megabytes = read_ahead_megabytes;
+            }
+
+            if (args["history-mb"])
+            {
+                const int history_megabytes = args["history-mb"].as<int>();
+
+                if (history_megabytes <= 0)
+                {
+                    throw std::logic_error{"History budget must be a positive number of megabytes"};
+                }
+                config.history_megabytes = history_megabytes;
+            }
+
+            if (args["packet-queue-mb"])
+            {
+                const int packet_queue_megabytes = args["packet-queue-mb"].as<int>();
+
+                if (packet_queue_megabytes <= 0)
+                {
+                    throw std::logic_error{"Packet queue budget must be a positive number of megabytes"};
+                }
+                config.packet_queue_megabytes = packet_queue_megabytes;
+            }
+
+            if (args["frame-queue-mb"])
+            {
+                const int frame_queue_megabytes = args["frame-queue-mb"].as<int>();
+
+                if (frame_queue_megabytes <= 0)
+                {
+                    throw std::logic_error{"Frame queue budget must be a positive number of megabytes"};
+                }
+                config.frame_queue_megabytes = frame_queue_megabytes;
+            }
+
+            if (args["conversion-threads"])
+            {
+                const int conversion_threads = args["conversion-threads"].as<int>();
+
+                if (conversion_threads <= 0)
+                {
+                    throw std::logic_error{"Number of conversion threads must be positive"};
+                }
+                config.conversion_threads = conversion_threads;
+            }
+
+            if (args["decoder-threads"])
+            {
+                const std::string decoder_threads = args["decoder-threads"].as<std::string>();
+                const std::regex decoder_threads_re("^([1-9][0-9]*)(?:,([1-9][0-9]*))?$");
+                std::smatch match;
+
+                if (!std::regex_match(decoder_threads, match, decoder_threads_re))
+                {
+                    throw std::logic_error{"Cannot parse decoder threads argument (must be N or LEFT,RIGHT)"};
+                }
+                config.decoder_threads[0] = std::stoul(match[1]);
+                config.decoder_threads[1] = match[2].matched ? std::stoul(match[2]) : config.decoder_threads[0];
+            }
+
+            if (args["decoder-thread-type"])
+            {
+                const std::string decoder_thread_type = args["decoder-thread-type"].as<std::string>();
+
+                if (decoder_thread_type == "frame")
+                {
+                    config.decoder_thread_type = DecoderThreadType::frame;
+                }
+                else if (decoder_thread_type == "slice")
+                {
+                    config.decoder_thread_type = DecoderThreadType::slice;
+                }
+                else if (decoder_thread_type != "auto")
+                {
+                    throw std::logic_error{"Decoder thread type must be frame, slice or auto"};
+                }
+            }
+
+            // written once the pipeline is gone, also after an error
+            std::unique_ptr<TraceSession> trace;
+
+            if (args["trace"])
+            {
+                trace = std::make_unique<TraceSession>(args["trace"].as<std::string>());
+            }
+
+            VideoCompare compare{config};
             compare();
         }
     }
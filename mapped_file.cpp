@@ -0,0 +1,153 @@
+#include "mapped_file.h"
+#include "ffmpeg.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Only for demuxer reads of headers and indexes; packets bypass it
+const int MappedFile::buffer_size_{64 * 1024};
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string &file_name) {
+#ifdef _WIN32
+	return nullptr;
+#else
+	const int descriptor = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (descriptor < 0) {
+		return nullptr;
+	}
+
+	struct stat file_status;
+
+	if (fstat(descriptor, &file_status) != 0 || !S_ISREG(file_status.st_mode) || file_status.st_size <= 0 ||
+		static_cast<uint64_t>(file_status.st_size) > SIZE_MAX) {
+		close(descriptor);
+		return nullptr;
+	}
+
+	const size_t size = file_status.st_size;
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+	// the mapping keeps the file open
+	close(descriptor);
+
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+
+	return std::unique_ptr<MappedFile>(new MappedFile(static_cast<uint8_t*>(data), size));
+#endif
+}
+
+MappedFile::MappedFile(uint8_t* data, size_t size) : data_{data}, size_{size} {
+	uint8_t* buffer = static_cast<uint8_t*>(av_malloc(buffer_size_));
+
+	if (buffer != nullptr) {
+		io_context_ = avio_alloc_context(buffer, buffer_size_, 0, this, read_packet, nullptr, seek);
+	}
+	if (io_context_ == nullptr) {
+		av_free(buffer);
+#ifndef _WIN32
+		munmap(data_, size_);
+#endif
+		throw ffmpeg::Error{"Couldn't allocate I/O context"};
+	}
+
+	io_context_->direct = 1;
+}
+
+MappedFile::~MappedFile() {
+	av_freep(&io_context_->buffer);
+	avio_context_free(&io_context_);
+#ifndef _WIN32
+	munmap(data_, size_);
+#endif
+}
+
+AVIOContext* MappedFile::io_context() const {
+	return io_context_;
+}
+
+void MappedFile::advise(int advice, int64_t position, size_t length) {
+#ifndef _WIN32
+	// madvise() wants a page aligned start
+	static const int64_t page_size = sysconf(_SC_PAGESIZE);
+	const int64_t start = std::min<int64_t>(position, size_) / page_size * page_size;
+	const size_t end = std::min(size_, static_cast<size_t>(position) + length);
+
+	if (end > static_cast<size_t>(start)) {
+		madvise(data_ + start, end - start, advice);
+	}
+#endif
+}
+
+void MappedFile::advise_sequential() {
+#ifndef _WIN32
+	advise(MADV_SEQUENTIAL, 0, size_);
+#endif
+}
+
+void MappedFile::advise_random() {
+#ifndef _WIN32
+	advise(MADV_RANDOM, 0, size_);
+#endif
+}
+
+void MappedFile::will_need(int64_t position, size_t length) {
+#ifndef _WIN32
+	if (position >= 0) {
+		advise(MADV_WILLNEED, position, length);
+	}
+#endif
+}
+
+int MappedFile::read_packet(void* opaque, uint8_t* buffer, int buffer_size) {
+	MappedFile* file = static_cast<MappedFile*>(opaque);
+
+	if (file->position_ >= static_cast<int64_t>(file->size_)) {
+		return AVERROR_EOF;
+	}
+
+	const int length = static_cast<int>(std::min<int64_t>(buffer_size, file->size_ - file->position_));
+
+	memcpy(buffer, file->data_ + file->position_, length);
+	file->position_ += length;
+
+	return length;
+}
+
+int64_t MappedFile::seek(void* opaque, int64_t offset, int whence) {
+	MappedFile* file = static_cast<MappedFile*>(opaque);
+	int64_t position;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return file->size_;
+	case SEEK_SET:
+		position = offset;
+		break;
+	case SEEK_CUR:
+		position = file->position_ + offset;
+		break;
+	case SEEK_END:
+		position = file->size_ + offset;
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+
+	if (position < 0) {
+		return AVERROR(EINVAL);
+	}
+
+	// past the end is fine, reads then hit EOF
+	file->position_ = position;
+
+	return position;
+}
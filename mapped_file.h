@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+extern "C" {
+	#include "libavformat/avio.h"
+}
+
+// Read-only mapping of a local file, read by libavformat through a custom
+// AVIOContext. Every read is a copy out of the page cache instead of a
+// read() syscall, and in direct mode large reads (whole ProRes or J2K
+// frames) are copied straight into the packet without the AVIO buffer.
+// Not available on Windows.
+class MappedFile {
+public:
+	// nullptr if the file cannot be mapped (URLs, pipes, empty files)
+	static std::unique_ptr<MappedFile> open(const std::string &file_name);
+	~MappedFile();
+	AVIOContext* io_context() const;
+	// Readahead hints: sequential while playing, random while seeking
+	void advise_sequential();
+	void advise_random();
+	// Start reading in the given range
+	void will_need(int64_t position, size_t length);
+private:
+	MappedFile(uint8_t* data, size_t size);
+	void advise(int advice, int64_t position, size_t length);
+	static int read_packet(void* opaque, uint8_t* buffer, int buffer_size);
+	static int64_t seek(void* opaque, int64_t offset, int whence);
+
+	static const int buffer_size_;
+
+	uint8_t* data_;
+	size_t size_;
+	int64_t position_{0};
+	AVIOContext* io_context_{};
+};
@@ -0,0 +1,227 @@
+#include "packet_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sys/stat.h>
+
+namespace {
+const char cache_magic[8] = {'V', 'C', 'I', 'D', 'X', '0', '0', '1'};
+
+struct CacheHeader {
+	char magic[8];
+	int64_t file_size;
+	int64_t file_mtime;
+	int32_t stream_index;
+	int32_t entry_size;
+	uint64_t entry_count;
+};
+}
+
+PacketIndex::PacketIndex(const std::string &file_name, const int stream_index) :
+	file_name_{file_name}, cache_file_name_{file_name + ".vcidx"}, stream_index_{stream_index} {
+	struct stat file_status;
+
+	if (stat(file_name_.c_str(), &file_status) == 0) {
+		file_size_ = file_status.st_size;
+		file_mtime_ = file_status.st_mtime;
+	}
+
+	if (load()) {
+		finalize();
+	} else {
+		builder_ = std::thread(&PacketIndex::build, this);
+	}
+}
+
+PacketIndex::~PacketIndex() {
+	abort_ = true;
+
+	if (builder_.joinable()) {
+		builder_.join();
+	}
+}
+
+void PacketIndex::wait() {
+	if (builder_.joinable()) {
+		builder_.join();
+	}
+}
+
+bool PacketIndex::ready() const {
+	return ready_.load(std::memory_order_acquire);
+}
+
+size_t PacketIndex::size() const {
+	return ready() ? entries_.size() : 0;
+}
+
+bool PacketIndex::keyframe_before(const int64_t target, PacketIndexEntry &entry) const {
+	if (!ready()) {
+		return false;
+	}
+
+	auto after = std::upper_bound(keyframes_.begin(), keyframes_.end(), target,
+		[](const int64_t t, const PacketIndexEntry &e) { return t < timestamp(e); });
+	if (after == keyframes_.begin()) {
+		return false;
+	}
+
+	entry = *(after - 1);
+	return true;
+}
+
+bool PacketIndex::keyframe_after(const int64_t target, PacketIndexEntry &entry) const {
+	if (!ready()) {
+		return false;
+	}
+
+	auto at = std::lower_bound(keyframes_.begin(), keyframes_.end(), target,
+		[](const PacketIndexEntry &e, const int64_t t) { return timestamp(e) < t; });
+	if (at == keyframes_.end()) {
+		return false;
+	}
+
+	entry = *at;
+	return true;
+}
+
+void PacketIndex::build() {
+	AVFormatContext* format_context{nullptr};
+
+	if (avformat_open_input(&format_context, file_name_.c_str(), nullptr, nullptr) < 0) {
+		return;
+	}
+	if (avformat_find_stream_info(format_context, nullptr) < 0 ||
+		stream_index_ >= static_cast<int>(format_context->nb_streams)) {
+		avformat_close_input(&format_context);
+		return;
+	}
+
+	// only the selected stream is of interest, so let the demuxer skip the rest
+	for (unsigned i = 0; i < format_context->nb_streams; ++i) {
+		if (static_cast<int>(i) != stream_index_) {
+			format_context->streams[i]->discard = AVDISCARD_ALL;
+		}
+	}
+
+	AVPacket* packet = av_packet_alloc();
+	bool complete = false;
+
+	while (packet != nullptr && !abort_) {
+		if (av_read_frame(format_context, packet) < 0) {
+			complete = true;
+			break;
+		}
+		if (packet->stream_index == stream_index_) {
+			entries_.push_back({packet->pts, packet->dts, packet->pos,
+				packet->size, packet->flags});
+		}
+		av_packet_unref(packet);
+	}
+
+	av_packet_free(&packet);
+	avformat_close_input(&format_context);
+
+	if (complete) {
+		finalize();
+		save();
+	}
+}
+
+bool PacketIndex::load() {
+	std::ifstream file(cache_file_name_, std::ios::binary);
+	CacheHeader header;
+
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+		header.file_size != file_size_ || header.file_mtime != file_mtime_ ||
+		header.stream_index != stream_index_ ||
+		header.entry_size != static_cast<int32_t>(sizeof(PacketIndexEntry))) {
+		return false;
+	}
+
+	// the count has to match what follows the header: a corrupt or truncated
+	// cache must not turn into a huge allocation
+	const std::streamoff entries_start = file.tellg();
+	file.seekg(0, std::ios::end);
+	const std::streamoff entries_bytes = file.tellg() - entries_start;
+	file.seekg(entries_start);
+
+	if (entries_start < 0 || entries_bytes < 0 ||
+		static_cast<uint64_t>(entries_bytes) % sizeof(PacketIndexEntry) != 0 ||
+		header.entry_count != static_cast<uint64_t>(entries_bytes) / sizeof(PacketIndexEntry)) {
+		return false;
+	}
+
+	entries_.resize(header.entry_count);
+
+	if (!file.read(reinterpret_cast<char*>(entries_.data()), entries_.size() * sizeof(PacketIndexEntry))) {
+		entries_.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void PacketIndex::save() const {
+	if (file_size_ < 0) {
+		return;
+	}
+
+	CacheHeader header;
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.file_size = file_size_;
+	header.file_mtime = file_mtime_;
+	header.stream_index = stream_index_;
+	header.entry_size = sizeof(PacketIndexEntry);
+	header.entry_count = entries_.size();
+
+	// written to a file of its own, then renamed over the cache, so a reader
+	// (e.g. the other side comparing a file with itself) never sees it half
+	// written; a failed write (e.g. read-only media) just means the next run
+	// rescans
+	const std::string temporary_name = cache_file_name_ + "." + std::to_string(
+		std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+		static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count())) + ".tmp";
+	{
+		std::ofstream file(temporary_name, std::ios::binary | std::ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries_.data()), entries_.size() * sizeof(PacketIndexEntry));
+		file.close();
+
+		if (!file) {
+			std::remove(temporary_name.c_str());
+			return;
+		}
+	}
+
+	if (std::rename(temporary_name.c_str(), cache_file_name_.c_str()) != 0) {
+		// Windows does not rename over an existing file
+		std::remove(cache_file_name_.c_str());
+
+		if (std::rename(temporary_name.c_str(), cache_file_name_.c_str()) != 0) {
+			std::remove(temporary_name.c_str());
+		}
+	}
+}
+
+void PacketIndex::finalize() {
+	for (const auto &entry : entries_) {
+		if ((entry.flags & AV_PKT_FLAG_KEY) && timestamp(entry) != AV_NOPTS_VALUE) {
+			keyframes_.push_back(entry);
+		}
+	}
+
+	std::sort(keyframes_.begin(), keyframes_.end(),
+		[](const PacketIndexEntry &a, const PacketIndexEntry &b) { return timestamp(a) < timestamp(b); });
+
+	ready_.store(true, std::memory_order_release);
+}
+
+int64_t PacketIndex::timestamp(const PacketIndexEntry &entry) {
+	return entry.pts != AV_NOPTS_VALUE ? entry.pts : entry.dts;
+}
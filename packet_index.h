@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+extern "C" {
+	#include "libavformat/avformat.h"
+}
+
+struct PacketIndexEntry {
+	int64_t pts;
+	int64_t dts;
+	int64_t pos;
+	int32_t size;
+	int32_t flags;
+};
+
+// Time stamp, byte position, size and keyframe flag of every packet of one
+// video stream. The index is built by a background pass that only demuxes
+// (nothing is decoded) and is cached next to the input as <file>.vcidx,
+// keyed by file size and modification time, so reopening a file is free.
+class PacketIndex {
+public:
+	PacketIndex(const std::string &file_name, const int stream_index);
+	~PacketIndex();
+	bool ready() const;
+	// Until the background pass, if one was started, has finished (whether
+	// or not it succeeded)
+	void wait();
+	size_t size() const;
+	// Last keyframe with a time stamp at or before target (stream time base)
+	bool keyframe_before(const int64_t target, PacketIndexEntry &entry) const;
+	// First keyframe with a time stamp at or after target (stream time base)
+	bool keyframe_after(const int64_t target, PacketIndexEntry &entry) const;
+	// Presentation time stamp, or decoding time stamp when it is missing
+	static int64_t timestamp(const PacketIndexEntry &entry);
+private:
+	void build();
+	bool load();
+	void save() const;
+	void finalize();
+
+	const std::string file_name_;
+	const std::string cache_file_name_;
+	const int stream_index_;
+	int64_t file_size_{-1};
+	int64_t file_mtime_{-1};
+
+	std::vector<PacketIndexEntry> entries_;
+	std::vector<PacketIndexEntry> keyframes_;
+
+	std::atomic_bool ready_{false};
+	std::atomic_bool abort_{false};
+	std::thread builder_;
+};
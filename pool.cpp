@@ -0,0 +1,192 @@
+#include "pool.h"
+#include "ffmpeg.h"
+#include <cstdint>
+extern "C" {
+	#include <libavutil/imgutils.h>
+}
+
+namespace {
+// enough to cover the queues plus the frames held by the display
+constexpr size_t initial_capacity{64};
+}
+
+PacketPool::PacketPool() {
+	free_.reserve(initial_capacity);
+}
+
+PacketPool::~PacketPool() {
+	for (auto packet : free_) {
+		av_packet_free(&packet);
+	}
+}
+
+std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> PacketPool::acquire() {
+	AVPacket* packet{nullptr};
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (!free_.empty()) {
+			packet = free_.back();
+			free_.pop_back();
+		}
+	}
+
+	if (packet == nullptr) {
+		packet = av_packet_alloc();
+		if (packet == nullptr) {
+			throw ffmpeg::Error{"Allocating packet"};
+		}
+		++allocations_;
+	}
+	++acquisitions_;
+
+	return {packet, [this](AVPacket* p){ release(p); }};
+}
+
+size_t PacketPool::allocations() const {
+	return allocations_;
+}
+
+size_t PacketPool::acquisitions() const {
+	return acquisitions_;
+}
+
+void PacketPool::release(AVPacket* packet) {
+	av_packet_unref(packet);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.push_back(packet);
+}
+
+FrameRefPool::FrameRefPool() {
+	free_.reserve(initial_capacity);
+}
+
+FrameRefPool::~FrameRefPool() {
+	for (auto frame : free_) {
+		av_frame_free(&frame);
+	}
+}
+
+std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> FrameRefPool::acquire() {
+	AVFrame* frame{nullptr};
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (!free_.empty()) {
+			frame = free_.back();
+			free_.pop_back();
+		}
+	}
+
+	if (frame == nullptr) {
+		frame = av_frame_alloc();
+		if (frame == nullptr) {
+			throw ffmpeg::Error{"Allocating frame"};
+		}
+		++allocations_;
+	}
+	++acquisitions_;
+
+	return {frame, [this](AVFrame* f){ release(f); }};
+}
+
+size_t FrameRefPool::allocations() const {
+	return allocations_;
+}
+
+size_t FrameRefPool::acquisitions() const {
+	return acquisitions_;
+}
+
+void FrameRefPool::release(AVFrame* frame) {
+	av_frame_unref(frame);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.push_back(frame);
+}
+
+FramePool::FramePool(size_t width, size_t height, AVPixelFormat pixel_format) :
+	width_{width}, height_{height}, pixel_format_{pixel_format} {
+	free_.reserve(initial_capacity);
+}
+
+FramePool::~FramePool() {
+	for (auto frame : free_) {
+		destroy(frame);
+	}
+}
+
+std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> FramePool::acquire() {
+	AVFrame* frame{nullptr};
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (!free_.empty()) {
+			frame = free_.back();
+			free_.pop_back();
+		}
+	}
+
+	if (frame == nullptr) {
+		frame = allocate();
+		++allocations_;
+	}
+	++acquisitions_;
+
+	return {frame, [this](AVFrame* f){ release(f); }};
+}
+
+size_t FramePool::allocations() const {
+	return allocations_;
+}
+
+size_t FramePool::acquisitions() const {
+	return acquisitions_;
+}
+
+AVFrame* FramePool::allocate() {
+	const int size = ffmpeg::check(av_image_get_buffer_size(
+		pixel_format_, width_, height_, alignment_));
+
+	std::unique_ptr<AVFrame, void(*)(AVFrame*)> frame{
+		av_frame_alloc(), &FramePool::destroy};
+	if (!frame) {
+		throw ffmpeg::Error{"Allocating frame"};
+	}
+
+	// av_malloc() only guarantees the alignment of the widest SIMD extension
+	// FFmpeg was configured with, so over-allocate and align by hand
+	void* memory = av_malloc(size + alignment_ - 1);
+	if (memory == nullptr) {
+		throw ffmpeg::Error{"Allocating picture"};
+	}
+	const uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+	uint8_t* buffer = reinterpret_cast<uint8_t*>((address + alignment_ - 1) & ~uintptr_t(alignment_ - 1));
+
+	// the buffer reference owns the allocation from here on
+	frame->buf[0] = av_buffer_create(
+		buffer, size, [](void* opaque, uint8_t*){ av_free(opaque); }, memory, 0);
+	if (frame->buf[0] == nullptr) {
+		av_free(memory);
+		throw ffmpeg::Error{"Allocating picture"};
+	}
+
+	ffmpeg::check(av_image_fill_arrays(
+		frame->data, frame->linesize, buffer,
+		pixel_format_, width_, height_, alignment_));
+	frame->width = width_;
+	frame->height = height_;
+	frame->format = pixel_format_;
+
+	return frame.release();
+}
+
+void FramePool::release(AVFrame* frame) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.push_back(frame);
+}
+
+void FramePool::destroy(AVFrame* frame) {
+	av_frame_free(&frame);
+}
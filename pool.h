@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+extern "C" {
+	#include "libavcodec/avcodec.h"
+}
+
+// The allocations() counters below count pool misses (an object had to be
+// allocated because none was free), not heap allocations in general: packet
+// payloads, the buffer references of decoded pictures and those libswscale
+// takes to convert in slices are allocated per frame outside these pools.
+
+// Recycles AVPackets between the demux and decode threads. Packets go back to
+// the pool when their owning unique_ptr is destroyed, so after warm-up no
+// AVPacket structs are allocated (the payload itself is owned by libavformat).
+class PacketPool {
+public:
+	PacketPool();
+	~PacketPool();
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> acquire();
+	size_t allocations() const;
+	size_t acquisitions() const;
+private:
+	void release(AVPacket* packet);
+
+	std::mutex mutex_;
+	std::vector<AVPacket*> free_;
+	std::atomic<size_t> allocations_{0};
+	std::atomic<size_t> acquisitions_{0};
+};
+
+// Recycles empty AVFrame structs that take over the buffer references of
+// decoded pictures (via av_frame_move_ref) for as long as they are queued or
+// kept in the history buffer.
+class FrameRefPool {
+public:
+	FrameRefPool();
+	~FrameRefPool();
+	std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> acquire();
+	size_t allocations() const;
+	size_t acquisitions() const;
+private:
+	void release(AVFrame* frame);
+
+	std::mutex mutex_;
+	std::vector<AVFrame*> free_;
+	std::atomic<size_t> allocations_{0};
+	std::atomic<size_t> acquisitions_{0};
+};
+
+// Recycles fixed-size frames with 64-byte aligned planes for the converted
+// pictures handed from a decode thread to the display. The planes are
+// reference counted (buf[0]) so libswscale's frame API can write into them.
+class FramePool {
+public:
+	FramePool(size_t width, size_t height, AVPixelFormat pixel_format);
+	~FramePool();
+	std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> acquire();
+	size_t allocations() const;
+	size_t acquisitions() const;
+private:
+	AVFrame* allocate();
+	void release(AVFrame* frame);
+	static void destroy(AVFrame* frame);
+
+	static constexpr int alignment_{64};
+
+	const size_t width_;
+	const size_t height_;
+	const AVPixelFormat pixel_format_;
+
+	std::mutex mutex_;
+	std::vector<AVFrame*> free_;
+	std::atomic<size_t> allocations_{0};
+	std::atomic<size_t> acquisitions_{0};
+};
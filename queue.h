@@ -1,36 +1,120 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <thread>
+#include <vector>
 #include <iostream>
 
 struct AVPacket;
-struct AVFrame;
+struct Frame;
+
+// Bounded single-producer/single-consumer ring buffer. Every queue in the
+// pipeline has exactly one producer (demux or decode task) and one consumer,
+// so push() and pop() only publish their own index with release/acquire
+// ordering. The mutex and condition variable are only touched when a side
+// actually has to block.
+//
+// Each item carries the seek epoch it was produced in. flush() raises the
+// oldest accepted epoch: stale items are dropped on push and on pop, and a
+// producer blocked on a full queue is woken so it can drop its item.
+//
+// A queue holds up to depth items and, optionally, up to a byte budget (one
+// item is always accepted, however large). The depth adapts: it grows by one
+// whenever the consumer finds the queue empty in the middle of an epoch (it
+// starved, so more buffering would have absorbed the hiccup), up to
+// depth_max, and shrinks to what is queued whenever the byte budget is what
+// blocks the producer.
+//
+// Sides that run as tasks on a thread pool use try_push() and try_pop(),
+// which never block, and register wake hooks: the consumer's hook is called
+// when an item arrives, the producer's when the queue has drained to half its
+// depth (so a producer task refills it in one go), and both when the queue is
+// flushed, finished or quit.
+enum class QueueStatus {
+	done,
+	would_block,
+	closed
+};
 
 template <class T>
 class Queue {
 protected:
+	static constexpr size_t cache_line_size_{64};
+	static constexpr int spin_count_{16};
+
+	static constexpr size_t depth_min_{2};
+
+	struct Slot {
+		T data;
+		uint64_t epoch{0};
+		size_t bytes{0};
+	};
+
 	// Data
-	std::queue<T> queue_;
-	typename std::queue<T>::size_type size_max_;
+	std::vector<Slot> ring_;
+	const size_t capacity_;
+	std::atomic<uint64_t> epoch_{0};
+
+	// Limits
+	std::atomic<size_t> depth_;
+	const size_t bytes_max_;
+	const std::function<size_t(const T &)> item_bytes_;
+	std::atomic<size_t> bytes_{0};
 
-	// Thread gubbins
+	// Producer index (monotonically increasing, own cache line)
+	char tail_padding_[cache_line_size_];
+	std::atomic<size_t> tail_{0};
+
+	// Consumer index (monotonically increasing, own cache line)
+	char head_padding_[cache_line_size_ - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> head_{0};
+	// Epoch of the last item popped (consumer only)
+	uint64_t popped_epoch_{UINT64_MAX};
+	char end_padding_[cache_line_size_ - sizeof(std::atomic<size_t>) - sizeof(uint64_t)];
+
+	// Thread gubbins (only used to park a blocked side)
+	std::atomic<int> waiters_{0};
 	std::mutex mutex_;
-	std::condition_variable full_;
-	std::condition_variable empty_;
+	std::condition_variable changed_;
+	std::function<void()> wake_producer_;
+	std::function<void()> wake_consumer_;
 
 	// Exit
 	std::atomic_bool quit_{false};
 	std::atomic_bool finished_{false};
 
 public:
-	Queue(const size_t size_max);
+	// A depth_max of 0 keeps the depth fixed; a bytes_max of 0 (or no
+	// item_bytes) means no byte budget
+	Queue(
+		const size_t depth, const size_t depth_max = 0, const size_t bytes_max = 0,
+		std::function<size_t(const T &)> item_bytes = nullptr);
+	// Defined out of the class body, so -Winline does not flag the calls
+	// on the paths where a queue is destroyed by an exception
+	~Queue();
 
-	bool push(T &&data);
+	// Returns false once the queue has quit or finished; items from a
+	// flushed epoch are silently dropped and count as pushed
+	bool push(T &&data, const uint64_t epoch = 0);
 	bool pop(T &data);
+	bool pop(T &data, uint64_t &epoch);
+
+	// Non-blocking: data is only moved from when done is returned (or the
+	// item was dropped as stale); closed once the queue has quit or finished
+	QueueStatus try_push(T &data, const uint64_t epoch = 0);
+	QueueStatus try_pop(T &data, uint64_t &epoch);
+
+	// Set before either side runs
+	void set_wake(std::function<void()> producer, std::function<void()> consumer);
+
+	// Drop everything older than epoch from now on
+	void flush(const uint64_t epoch);
 
 	// The queue has finished accepting input
     bool isFinished();
@@ -38,58 +122,208 @@ public:
 	// The queue will cannot be pushed or popped
 	void quit();
 
-    void empty();
+	// Current limit on the number of items, and the memory they hold
+	size_t depth() const;
+	size_t bytes() const;
+	// Items queued right now (a snapshot, for statistics)
+	size_t size() const;
+
+private:
+	bool fits(const size_t tail, const size_t bytes) const;
+	QueueStatus try_push(T &data, const uint64_t epoch, const size_t bytes);
+
+	template <class Predicate>
+	void wait(Predicate ready);
+	void wake();
+	void wake_producer();
+	void wake_consumer();
 };
 
 using PacketQueue =
 	Queue<std::unique_ptr<AVPacket, std::function<void(AVPacket*)>>>;
 using FrameQueue =
-	Queue<std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>>;
+	Queue<Frame>;
 
 template <class T>
-Queue<T>::Queue(size_t size_max) :
-		size_max_{size_max} {
+Queue<T>::Queue(
+	const size_t depth, const size_t depth_max, const size_t bytes_max,
+	std::function<size_t(const T &)> item_bytes) :
+		ring_(std::max<size_t>({depth, depth_max, 1})), capacity_{ring_.size()},
+		depth_{std::max<size_t>(depth, 1)},
+		bytes_max_{item_bytes ? bytes_max : 0}, item_bytes_{std::move(item_bytes)} {
 }
 
 template <class T>
-bool Queue<T>::push(T &&data) {
-	std::unique_lock<std::mutex> lock(mutex_);
+Queue<T>::~Queue() {
+}
 
-	while (!quit_ && !finished_) {
+template <class T>
+bool Queue<T>::fits(const size_t tail, const size_t bytes) const {
+	const size_t queued = tail - head_.load(std::memory_order_acquire);
+
+	return queued < depth_.load(std::memory_order_relaxed) &&
+		(bytes_max_ == 0 || queued == 0 || (bytes_.load(std::memory_order_relaxed) + bytes) <= bytes_max_);
+}
 
-		if (queue_.size() < size_max_) {
-			queue_.push(std::move(data));
+template <class T>
+bool Queue<T>::push(T &&data, const uint64_t epoch) {
+	const size_t bytes = bytes_max_ > 0 ? item_bytes_(data) : 0;
 
-			empty_.notify_all();
+	for (;;) {
+		switch (try_push(data, epoch, bytes)) {
+		case QueueStatus::done:
 			return true;
-		} else {
-			full_.wait(lock);
+		case QueueStatus::closed:
+			return false;
+		case QueueStatus::would_block:
+			break;
 		}
+
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+
+		wait([this, tail, bytes, epoch] {
+			return quit_ || finished_ || epoch < epoch_ || fits(tail, bytes);
+		});
 	}
+}
 
-	return false;
+template <class T>
+QueueStatus Queue<T>::try_push(T &data, const uint64_t epoch) {
+	return try_push(data, epoch, bytes_max_ > 0 ? item_bytes_(data) : 0);
 }
 
 template <class T>
-bool Queue<T>::pop(T &data) {
-	std::unique_lock<std::mutex> lock(mutex_);
+QueueStatus Queue<T>::try_push(T &data, const uint64_t epoch, const size_t bytes) {
+	if (quit_ || finished_) {
+		return QueueStatus::closed;
+	}
+	if (epoch < epoch_) {
+		T discarded{std::move(data)};
+		return QueueStatus::done;
+	}
 
-	while (!quit_) {
+	const size_t tail = tail_.load(std::memory_order_relaxed);
+
+	if (fits(tail, bytes)) {
+		Slot &slot = ring_[tail % capacity_];
+		slot.data = std::move(data);
+		slot.epoch = epoch;
+		slot.bytes = bytes;
+		bytes_.fetch_add(bytes, std::memory_order_relaxed);
+		tail_.store(tail + 1, std::memory_order_release);
+
+		wake_consumer();
+		return QueueStatus::done;
+	}
+
+	const size_t queued = tail - head_.load(std::memory_order_acquire);
+	size_t depth = depth_.load(std::memory_order_relaxed);
+
+	// Out of memory budget before running out of depth. The consumer may
+	// grow the depth at the same time (it starved, which is more recent news
+	// than this budget check): then the exchange fails and its growth stands
+	if (queued < depth) {
+		depth_.compare_exchange_strong(depth, std::max(queued, depth_min_), std::memory_order_relaxed);
+	}
+
+	return QueueStatus::would_block;
+}
 
-		if (!queue_.empty()) {
-			data = std::move(queue_.front());
-			queue_.pop();
+template <class T>
+bool Queue<T>::pop(T &data) {
+	uint64_t epoch;
+	return pop(data, epoch);
+}
 
-			full_.notify_all();
+template <class T>
+bool Queue<T>::pop(T &data, uint64_t &epoch) {
+	for (;;) {
+		switch (try_pop(data, epoch)) {
+		case QueueStatus::done:
 			return true;
-		} else if (queue_.empty() && finished_) {
+		case QueueStatus::closed:
 			return false;
-		} else {
-			empty_.wait(lock);
+		case QueueStatus::would_block:
+			break;
 		}
+
+		const size_t head = head_.load(std::memory_order_relaxed);
+
+		wait([this, head] {
+			return quit_ || finished_ ||
+				head != tail_.load(std::memory_order_acquire);
+		});
 	}
+}
+
+template <class T>
+QueueStatus Queue<T>::try_pop(T &data, uint64_t &epoch) {
+	while (!quit_) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+
+		if (head != tail_.load(std::memory_order_acquire)) {
+			Slot &slot = ring_[head % capacity_];
+			const bool stale = slot.epoch < epoch_;
 
-	return false;
+			if (stale) {
+				T discarded{std::move(slot.data)};
+			} else {
+				data = std::move(slot.data);
+				epoch = slot.epoch;
+				popped_epoch_ = slot.epoch;
+			}
+			bytes_.fetch_sub(slot.bytes, std::memory_order_relaxed);
+			head_.store(head + 1, std::memory_order_release);
+
+			wake();
+
+			// Hysteresis for a producer task: waking it for every free slot
+			// would schedule it once per item, so it is only woken once the
+			// queue has drained to half its depth and can refill it in one
+			// step. A blocked push() is still woken above on every pop.
+			if (wake_producer_ &&
+				tail_.load(std::memory_order_acquire) - (head + 1) <= depth_.load(std::memory_order_relaxed) / 2) {
+				wake_producer_();
+			}
+
+			if (stale) {
+				continue;
+			}
+			return QueueStatus::done;
+		}
+
+		// Starved while the producer is still at it: buffer more next time
+		if (!finished_ && popped_epoch_ == epoch_ && depth_.load(std::memory_order_relaxed) < capacity_) {
+			depth_.fetch_add(1, std::memory_order_relaxed);
+			popped_epoch_ = UINT64_MAX;
+		}
+
+		if (!finished_) {
+			return QueueStatus::would_block;
+		}
+		// re-check after observing finished_ so the final pushes are not lost
+		if (head == tail_.load(std::memory_order_acquire)) {
+			return QueueStatus::closed;
+		}
+	}
+
+	return QueueStatus::closed;
+}
+
+template <class T>
+void Queue<T>::set_wake(std::function<void()> producer, std::function<void()> consumer) {
+	wake_producer_ = std::move(producer);
+	wake_consumer_ = std::move(consumer);
+}
+
+template <class T>
+void Queue<T>::flush(const uint64_t epoch) {
+	uint64_t current = epoch_;
+
+	while (current < epoch && !epoch_.compare_exchange_weak(current, epoch)) {
+	}
+	wake_producer();
+	wake_consumer();
 }
 
 template <class T>
@@ -100,23 +334,80 @@ bool Queue<T>::isFinished() {
 template <class T>
 void Queue<T>::finished() {
 	finished_ = true;
-	empty_.notify_all();
+	wake_producer();
+	wake_consumer();
 }
 
 template <class T>
 void Queue<T>::quit() {
 	quit_ = true;
-	empty_.notify_all();
-	full_.notify_all();
+	wake_producer();
+	wake_consumer();
+}
+
+template <class T>
+size_t Queue<T>::depth() const {
+	return depth_.load(std::memory_order_relaxed);
 }
 
 template <class T>
-void Queue<T>::empty() {
+size_t Queue<T>::bytes() const {
+	return bytes_.load(std::memory_order_relaxed);
+}
+
+template <class T>
+size_t Queue<T>::size() const {
+	// head first: the tail never falls behind it
+	const size_t head = head_.load(std::memory_order_acquire);
+
+	return tail_.load(std::memory_order_acquire) - head;
+}
+
+template <class T>
+template <class Predicate>
+void Queue<T>::wait(Predicate ready) {
+	// the other side usually catches up within a few time slices
+	for (int spin = 0; spin < spin_count_; ++spin) {
+		if (ready()) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+
 	std::unique_lock<std::mutex> lock(mutex_);
 
-    while(!queue_.empty()) {
-        queue_.pop();
-    }
+	waiters_.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	changed_.wait(lock, ready);
+	waiters_.fetch_sub(1);
+}
+
+template <class T>
+void Queue<T>::wake() {
+	// pairs with the fence in wait(): either the waiter sees the new index
+	// or we see the waiter and notify it under the mutex
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 
-	full_.notify_all();
-}
\ No newline at end of file
+	if (waiters_.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed_.notify_all();
+	}
+}
+
+template <class T>
+void Queue<T>::wake_producer() {
+	wake();
+
+	if (wake_producer_) {
+		wake_producer_();
+	}
+}
+
+template <class T>
+void Queue<T>::wake_consumer() {
+	wake();
+
+	if (wake_consumer_) {
+		wake_consumer_();
+	}
+}
@@ -0,0 +1,199 @@
+#include "read_ahead.h"
+#include "ffmpeg.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Large enough that a slow mount sees few, big requests
+const size_t ReadAhead::block_size_{4 * 1024 * 1024};
+// Only for demuxer reads of headers and indexes; packets bypass it
+const int ReadAhead::buffer_size_{64 * 1024};
+
+ReadAhead::ReadAhead(const std::string &url, const size_t capacity) {
+	ffmpeg::check(avio_open2(&source_, url.c_str(), AVIO_FLAG_READ, nullptr, nullptr));
+	size_ = avio_size(source_);
+
+	ring_.resize(std::max(capacity / block_size_, size_t(2)) * block_size_);
+
+	uint8_t* buffer = static_cast<uint8_t*>(av_malloc(buffer_size_));
+
+	if (buffer != nullptr) {
+		io_context_ = avio_alloc_context(buffer, buffer_size_, 0, this, read_packet, nullptr, seek);
+	}
+	if (io_context_ == nullptr) {
+		av_free(buffer);
+		avio_closep(&source_);
+		throw ffmpeg::Error{"Couldn't allocate I/O context"};
+	}
+
+	io_context_->direct = 1;
+
+	thread_ = std::thread(&ReadAhead::read_ahead, this);
+}
+
+ReadAhead::~ReadAhead() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	drained_.notify_one();
+	filled_.notify_one();
+	thread_.join();
+
+	av_freep(&io_context_->buffer);
+	avio_context_free(&io_context_);
+	avio_closep(&source_);
+}
+
+AVIOContext* ReadAhead::io_context() const {
+	return io_context_;
+}
+
+float ReadAhead::fill() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return static_cast<float>(end_ - consumed_) / ring_.size();
+}
+
+std::chrono::milliseconds ReadAhead::stalled() const {
+	return std::chrono::milliseconds(stalled_microseconds_ / 1000);
+}
+
+void ReadAhead::read_ahead() {
+	const int64_t capacity = ring_.size();
+	// Position of source_, -1 after a failed seek
+	int64_t source_position = 0;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	for (;;) {
+		drained_.wait(lock, [&] {
+			return quit_ || (error_ == 0 && (capacity - (end_ - begin_)) >= static_cast<int64_t>(block_size_));
+		});
+		if (quit_) {
+			break;
+		}
+
+		const uint64_t generation = generation_;
+		const int64_t position = end_;
+		const int64_t offset = position % capacity;
+		const int length = static_cast<int>(std::min({
+			static_cast<int64_t>(block_size_), capacity - offset, capacity - (end_ - begin_)}));
+
+		lock.unlock();
+
+		// The demux thread does not touch the ring past end_
+		int result = 0;
+
+		if (position != source_position) {
+			const int64_t seeked = avio_seek(source_, position, SEEK_SET);
+
+			source_position = seeked < 0 ? -1 : position;
+			result = seeked < 0 ? static_cast<int>(seeked) : 0;
+		}
+		if (result == 0) {
+			result = avio_read(source_, ring_.data() + offset, length);
+
+			if (result > 0) {
+				source_position += result;
+			}
+		}
+
+		lock.lock();
+
+		// The demux thread moved elsewhere in the meantime
+		if (generation != generation_) {
+			continue;
+		}
+
+		if (result > 0) {
+			end_ += result;
+		} else {
+			error_ = result == 0 ? AVERROR_EOF : result;
+		}
+		filled_.notify_one();
+	}
+}
+
+int ReadAhead::read(uint8_t* buffer, const int size) {
+	const int64_t capacity = ring_.size();
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	// A seek: start over from the new position
+	if (position_ < begin_ || position_ > end_) {
+		begin_ = consumed_ = end_ = position_;
+		error_ = 0;
+		++generation_;
+		drained_.notify_one();
+	}
+
+	if (position_ == end_ && error_ == 0) {
+		const auto wait_started = std::chrono::steady_clock::now();
+
+		filled_.wait(lock, [&] { return end_ > position_ || error_ != 0 || quit_; });
+
+		stalled_microseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - wait_started).count();
+	}
+
+	if (position_ >= end_) {
+		return error_ != 0 ? error_ : AVERROR_EOF;
+	}
+
+	const int length = static_cast<int>(std::min<int64_t>(size, end_ - position_));
+	lock.unlock();
+
+	// The I/O thread only writes past end_, so this range stays put
+	const int64_t offset = position_ % capacity;
+	const int first = static_cast<int>(std::min<int64_t>(length, capacity - offset));
+
+	memcpy(buffer, ring_.data() + offset, first);
+	memcpy(buffer + first, ring_.data(), length - first);
+
+	position_ += length;
+
+	lock.lock();
+	consumed_ = position_;
+	begin_ = std::max(begin_, consumed_ - static_cast<int64_t>(block_size_));
+	drained_.notify_one();
+
+	return length;
+}
+
+int ReadAhead::read_packet(void* opaque, uint8_t* buffer, int buffer_size) {
+	return static_cast<ReadAhead*>(opaque)->read(buffer, buffer_size);
+}
+
+int64_t ReadAhead::seek(void* opaque, int64_t offset, int whence) {
+	ReadAhead* read_ahead = static_cast<ReadAhead*>(opaque);
+	int64_t position;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return read_ahead->size_;
+	case SEEK_SET:
+		position = offset;
+		break;
+	case SEEK_CUR:
+		position = read_ahead->position_ + offset;
+		break;
+	case SEEK_END:
+		if (read_ahead->size_ < 0) {
+			return read_ahead->size_;
+		}
+		position = read_ahead->size_ + offset;
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+
+	if (position < 0) {
+		return AVERROR(EINVAL);
+	}
+
+	// Served (or re-targeted) by the next read
+	read_ahead->position_ = position;
+
+	return position;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+extern "C" {
+	#include "libavformat/avio.h"
+}
+
+// Reads an input ahead of the demuxer on its own thread, in large blocks into
+// a ring buffer, so a stalling (network) mount is absorbed by the buffer
+// instead of blocking av_read_frame(). libavformat reads through a custom
+// AVIOContext served from the ring; a read outside the buffered range (i.e.
+// after a seek) drops the buffer and restarts reading ahead from there.
+class ReadAhead {
+public:
+	ReadAhead(const std::string &url, const size_t capacity);
+	~ReadAhead();
+	AVIOContext* io_context() const;
+	// Share of the ring filled ahead of the read position (0 to 1)
+	float fill() const;
+	// Total time the demuxer waited for data
+	std::chrono::milliseconds stalled() const;
+private:
+	void read_ahead();
+	int read(uint8_t* buffer, const int size);
+	static int read_packet(void* opaque, uint8_t* buffer, int buffer_size);
+	static int64_t seek(void* opaque, int64_t offset, int whence);
+
+	static const size_t block_size_;
+	static const int buffer_size_;
+
+	AVIOContext* source_{};
+	int64_t size_;
+	std::vector<uint8_t> ring_;
+	AVIOContext* io_context_{};
+
+	// Read position of the demuxer
+	int64_t position_{0};
+
+	// The ring holds the range [begin_, end_) of the input, byte i at
+	// i % ring_.size(). The demux thread only reads inside it and moves
+	// begin_ up (keeping one block behind the read position for short seeks
+	// back); the I/O thread only writes past end_, then moves end_ up.
+	// A new generation_ discards whatever the I/O thread is reading.
+	mutable std::mutex mutex_;
+	std::condition_variable filled_;
+	std::condition_variable drained_;
+	int64_t begin_{0};
+	int64_t consumed_{0};
+	int64_t end_{0};
+	uint64_t generation_{0};
+	// AVERROR_EOF or the read error at end_
+	int error_{0};
+	bool quit_{false};
+
+	std::atomic<int64_t> stalled_microseconds_{0};
+	std::thread thread_;
+};
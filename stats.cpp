@@ -0,0 +1,238 @@
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+const int sides = 2;
+const int series_count = static_cast<int>(Stage::count) * sides;
+
+// Values below 8 us get a bucket each, then 8 buckets per octave up to
+// 2^27 us (over two minutes); longer goes into the last bucket
+const int linear_buckets = 8;
+const int octaves = 24;
+const int bucket_count = linear_buckets + octaves * 8;
+
+thread_local int side_in_scope = 0;
+
+int bucket(const uint64_t microseconds) {
+	if (microseconds < linear_buckets) {
+		return static_cast<int>(microseconds);
+	}
+
+	int octave = 3;
+	while ((microseconds >> (octave + 1)) != 0) {
+		++octave;
+	}
+	const int sub = static_cast<int>((microseconds >> (octave - 3)) & 7);
+	octave = std::min(octave - 3, octaves - 1);
+
+	return std::min(linear_buckets + octave * 8 + sub, bucket_count - 1);
+}
+
+// Middle of a bucket, in microseconds
+double bucket_value(const int index) {
+	if (index < linear_buckets) {
+		return index;
+	}
+
+	const int octave = (index - linear_buckets) / 8 + 3;
+	const int sub = (index - linear_buckets) % 8;
+	const double width = static_cast<double>(uint64_t(1) << (octave - 3));
+
+	return (8 + sub) * width + width / 2.0;
+}
+
+struct ThreadHistograms {
+	std::atomic<uint32_t> counts[series_count][bucket_count];
+	std::atomic<uint64_t> max[series_count];
+
+	ThreadHistograms() {
+		for (int series = 0; series < series_count; ++series) {
+			for (int i = 0; i < bucket_count; ++i) {
+				counts[series][i].store(0, std::memory_order_relaxed);
+			}
+			max[series].store(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+// Histograms of every thread that ever recorded (threads come from a fixed
+// pool, so they are simply kept until exit)
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadHistograms>> threads;
+};
+
+Registry &registry() {
+	static Registry instance;
+
+	return instance;
+}
+
+ThreadHistograms &thread_histograms() {
+	thread_local ThreadHistograms *histograms = nullptr;
+
+	if (histograms == nullptr) {
+		Registry &shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+
+		shared.threads.push_back(std::make_unique<ThreadHistograms>());
+		histograms = shared.threads.back().get();
+	}
+
+	return *histograms;
+}
+
+}
+
+const char *stage_name(const Stage stage) {
+	switch (stage) {
+	case Stage::demux:
+		return "demux";
+	case Stage::decode:
+		return "decode";
+	case Stage::conversion:
+		return "conversion";
+	case Stage::frame_wait:
+		return "frame wait";
+	case Stage::difference:
+		return "difference";
+	case Stage::upload:
+		return "upload";
+	case Stage::present:
+		return "present";
+	default:
+		return "?";
+	}
+}
+
+void record_stage(const Stage stage, const int side, const std::chrono::steady_clock::duration duration) {
+	const uint64_t microseconds = std::max<int64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0);
+	const int series = static_cast<int>(stage) * sides + side;
+	ThreadHistograms &histograms = thread_histograms();
+
+	// only this thread writes, readers just need untorn values
+	std::atomic<uint32_t> &count = histograms.counts[series][bucket(microseconds)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	if (microseconds > histograms.max[series].load(std::memory_order_relaxed)) {
+		histograms.max[series].store(microseconds, std::memory_order_relaxed);
+	}
+}
+
+StageSummary stage_summary(const Stage stage, const int side) {
+	const int series = static_cast<int>(stage) * sides + side;
+	uint64_t counts[bucket_count] = {};
+	uint64_t max = 0;
+
+	{
+		Registry &shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+
+		for (const auto &histograms : shared.threads) {
+			for (int i = 0; i < bucket_count; ++i) {
+				counts[i] += histograms->counts[series][i].load(std::memory_order_relaxed);
+			}
+			max = std::max(max, histograms->max[series].load(std::memory_order_relaxed));
+		}
+	}
+
+	StageSummary summary;
+
+	for (int i = 0; i < bucket_count; ++i) {
+		summary.count += counts[i];
+	}
+	if (summary.count == 0) {
+		return summary;
+	}
+
+	// smallest bucket holding at least the given share of all values
+	auto percentile = [&](const double share) {
+		const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(share * summary.count + 0.5));
+		uint64_t seen = 0;
+
+		for (int i = 0; i < bucket_count; ++i) {
+			seen += counts[i];
+
+			if (seen >= rank) {
+				return std::min(bucket_value(i), static_cast<double>(max)) / 1000.0;
+			}
+		}
+		return max / 1000.0;
+	};
+
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	summary.max = max / 1000.0;
+
+	return summary;
+}
+
+bool stage_per_side(const Stage stage) {
+	return stage == Stage::demux || stage == Stage::decode || stage == Stage::conversion || stage == Stage::frame_wait;
+}
+
+SideScope::SideScope(const int side) : previous_{side_in_scope} {
+	side_in_scope = side;
+}
+
+SideScope::~SideScope() {
+	side_in_scope = previous_;
+}
+
+int current_side() {
+	return side_in_scope;
+}
+
+std::string stage_statistics() {
+	static const char *side_names[sides] = {"left", "right"};
+	std::string statistics;
+
+	for (int index = 0; index < static_cast<int>(Stage::count); ++index) {
+		const Stage stage = static_cast<Stage>(index);
+
+		for (int side = 0; side < (stage_per_side(stage) ? sides : 1); ++side) {
+			const StageSummary summary = stage_summary(stage, side);
+
+			if (summary.count == 0) {
+				continue;
+			}
+
+			char line[160];
+			snprintf(line, sizeof(line), "%s%s%s: %llux p50 %.2f p95 %.2f p99 %.2f max %.2f ms\n",
+				stage_name(stage), stage_per_side(stage) ? " " : "", stage_per_side(stage) ? side_names[side] : "",
+				static_cast<unsigned long long>(summary.count), summary.p50, summary.p95, summary.p99, summary.max);
+			statistics += line;
+		}
+	}
+
+	return statistics;
+}
+
+void QueueOccupancy::sample(const size_t queued, const size_t depth) {
+	++samples_;
+	sum_ += queued;
+	queued_ = queued;
+	depth_ = depth;
+	max_ = std::max(max_, queued);
+
+	if (queued == 0) {
+		++empty_;
+	}
+}
+
+std::string QueueOccupancy::summary() const {
+	char summary[96];
+
+	snprintf(summary, sizeof(summary), "%zu/%zu (mean %.1f, max %zu, empty %d%%)", queued_, depth_,
+		samples_ > 0 ? static_cast<double>(sum_) / samples_ : 0.0, max_,
+		samples_ > 0 ? static_cast<int>(empty_ * 100 / samples_) : 0);
+
+	return summary;
+}
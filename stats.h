@@ -0,0 +1,113 @@
+#pragma once
+#include "trace.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Where the time goes in the pipeline: every thread records how long each
+// piece of work took into latency histograms of its own (single writer, so
+// recording is a couple of relaxed atomic stores and never waits for anyone);
+// summaries merge the histograms of all threads. Buckets are log-linear,
+// 8 per octave of microseconds, so percentiles are within about 6%.
+enum class Stage {
+	// reading one packet (per side)
+	demux,
+	// sending one packet and receiving the frames it completed (per side)
+	decode,
+	// one FormatConverter call (per side, see SideScope)
+	conversion,
+	// the video thread waiting for the next frame of a side
+	frame_wait,
+	// subtraction mode difference of the visible area
+	difference,
+	// texture uploads of one refresh
+	upload,
+	// SDL_RenderPresent() of one refresh
+	present,
+	count
+};
+
+// Side is 0 or 1 for the stages done per side, 0 for the others
+void record_stage(const Stage stage, const int side, const std::chrono::steady_clock::duration duration);
+const char *stage_name(const Stage stage);
+bool stage_per_side(const Stage stage);
+
+// Records the time from construction to destruction, and traces it as an
+// event when tracing
+class StageTimer {
+public:
+	explicit StageTimer(const Stage stage, const int side = 0) :
+		stage_{stage}, side_{side}, start_{std::chrono::steady_clock::now()} {
+	}
+	~StageTimer() {
+		const auto end = std::chrono::steady_clock::now();
+
+		record_stage(stage_, side_, end - start_);
+
+		if (tracing()) {
+			trace_event(stage_name(stage_), stage_per_side(stage_) ? side_ : -1, pts_, start_, end);
+		}
+	}
+
+	StageTimer(const StageTimer &) = delete;
+	StageTimer &operator=(const StageTimer &) = delete;
+
+	// Time stamp (microseconds) of what was worked on, for the trace
+	void set_pts(const int64_t pts) {
+		pts_ = pts;
+	}
+
+private:
+	const Stage stage_;
+	const int side_;
+	const std::chrono::steady_clock::time_point start_;
+	int64_t pts_{INT64_MIN};
+};
+
+// The side the calling thread works on while in scope, for stages that
+// cannot tell by themselves (a converter serves whoever calls it)
+class SideScope {
+public:
+	explicit SideScope(const int side);
+	~SideScope();
+
+	SideScope(const SideScope &) = delete;
+	SideScope &operator=(const SideScope &) = delete;
+
+private:
+	const int previous_;
+};
+
+// 0 outside of any SideScope
+int current_side();
+
+// Latencies in milliseconds, of everything recorded so far
+struct StageSummary {
+	uint64_t count{0};
+	double p50{0.0};
+	double p95{0.0};
+	double p99{0.0};
+	double max{0.0};
+};
+
+StageSummary stage_summary(const Stage stage, const int side);
+// One line per stage (and side) that recorded anything, e.g.
+// "decode left: 1204x p50 3.10 p95 7.98 p99 12.4 max 20.1 ms"
+std::string stage_statistics();
+
+// Fill level of a queue sampled over time, by one thread
+class QueueOccupancy {
+public:
+	void sample(const size_t queued, const size_t depth);
+	// e.g. "3/12 (mean 5.2, max 12, empty 4%)"
+	std::string summary() const;
+
+private:
+	uint64_t samples_{0};
+	uint64_t empty_{0};
+	uint64_t sum_{0};
+	size_t queued_{0};
+	size_t depth_{0};
+	size_t max_{0};
+};
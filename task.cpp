@@ -0,0 +1,78 @@
+#include "task.h"
+
+Task::Task(ThreadPool &thread_pool, std::function<Status()> step) :
+	thread_pool_{thread_pool}, step_{std::move(step)} {
+}
+
+Task::~Task() {
+}
+
+void Task::start() {
+	wake();
+}
+
+void Task::wake() {
+	State state = state_.load();
+
+	for (;;) {
+		switch (state) {
+		case State::idle:
+			if (state_.compare_exchange_weak(state, State::scheduled)) {
+				schedule();
+				return;
+			}
+			break;
+		case State::running:
+			if (state_.compare_exchange_weak(state, State::rerun)) {
+				return;
+			}
+			break;
+		default:
+			// already going to run (again), or finished
+			return;
+		}
+	}
+}
+
+void Task::wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	finished_.wait(lock, [this] {
+		return done_;
+	});
+}
+
+void Task::schedule() {
+	thread_pool_.submit([this] {
+		run();
+	});
+}
+
+void Task::run() {
+	state_.store(State::running);
+
+	switch (step_()) {
+	case Status::progress:
+		state_.store(State::scheduled);
+		schedule();
+		break;
+	case Status::blocked: {
+		State state = State::running;
+
+		if (!state_.compare_exchange_strong(state, State::idle)) {
+			// woken while running: whatever it waited for may be there now
+			state_.store(State::scheduled);
+			schedule();
+		}
+		break;
+	}
+	case Status::done: {
+		state_.store(State::finished);
+
+		// notify under the lock: the task may be destroyed once wait() returns
+		std::lock_guard<std::mutex> lock(mutex_);
+		done_ = true;
+		finished_.notify_all();
+		break;
+	}
+	}
+}
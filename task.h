@@ -0,0 +1,48 @@
+#pragma once
+#include "thread_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// A resumable job on a ThreadPool: step() does a bounded piece of work and
+// says whether there is more to do right away (progress), whether it has to
+// wait for something (blocked: it returns to the pool and runs again once
+// wake() is called) or whether it has finished (done). A task never runs on
+// two threads at once; a wake() while it runs makes it run again afterwards,
+// so wake-ups are never lost. step() must not throw.
+class Task {
+public:
+	enum class Status {
+		progress,
+		blocked,
+		done
+	};
+
+	Task(ThreadPool &thread_pool, std::function<Status()> step);
+	~Task();
+
+	void start();
+	void wake();
+	// Until step() returned done
+	void wait();
+
+private:
+	enum class State {
+		idle,
+		scheduled,
+		running,
+		rerun,
+		finished
+	};
+
+	void schedule();
+	void run();
+
+	ThreadPool &thread_pool_;
+	const std::function<Status()> step_;
+	std::atomic<State> state_{State::idle};
+	std::mutex mutex_;
+	std::condition_variable finished_;
+	bool done_{false};
+};
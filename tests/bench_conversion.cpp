@@ -0,0 +1,67 @@
+// Frame conversion to RGB24 with 1, 2, 4 and 8 conversion threads (what
+// --conversion-threads sets): scaled and same-size through swscale slices,
+// and same-size through the kernels of yuv_to_rgb.h in bands of rows
+#include "format_converter.h"
+#include "ffmpeg.h"
+#include "thread_pool.h"
+#include "test.h"
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace {
+using FramePointer = std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>;
+
+FramePointer allocate(const int width, const int height, const AVPixelFormat format) {
+	FramePointer frame{av_frame_alloc(), [](AVFrame* f) { av_frame_free(&f); }};
+
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	frame->colorspace = AVCOL_SPC_BT709;
+	frame->color_range = AVCOL_RANGE_MPEG;
+	ffmpeg::check(av_frame_get_buffer(frame.get(), 0));
+
+	// mid grey with a ramp, as valid for 8 as for 16-bit samples
+	for (int plane = 0; plane < AV_NUM_DATA_POINTERS && frame->buf[plane] != nullptr; ++plane) {
+		for (size_t i = 0; i < frame->buf[plane]->size; ++i) {
+			frame->buf[plane]->data[i] = static_cast<uint8_t>(i % 2 == 1 ? 0x01 : 0x80 + i % 64);
+		}
+	}
+
+	return frame;
+}
+
+void bench(const char* name, const int src_width, const int src_height, const int dest_width, const int dest_height,
+	const AVPixelFormat format, const bool use_kernels) {
+	FramePointer src = allocate(src_width, src_height, format);
+	FramePointer dst = allocate(dest_width, dest_height, AV_PIX_FMT_RGB24);
+	double single = 0.0;
+
+	printf("%s\n", name);
+
+	for (const size_t threads : {1, 2, 4, 8}) {
+		ThreadPool pool(threads);
+		FormatConverter converter(src_width, src_height, dest_width, dest_height, format, AV_PIX_FMT_RGB24, &pool, use_kernels);
+		const double seconds = test::best_time(20, [&]() { converter(src.get(), dst.get()); });
+
+		if (threads == 1) {
+			single = seconds;
+		}
+		printf("  %zu thread(s) %8.2f ms/frame %6.2fx\n", threads, seconds * 1000.0, single / seconds);
+	}
+}
+}
+
+int main() {
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+	bench("2160p yuv420p10le -> 1080p RGB24 (swscale, scaled)", 3840, 2160, 1920, 1080, AV_PIX_FMT_YUV420P10LE, true);
+	bench("2160p yuv420p10le -> 2160p RGB24 (swscale)", 3840, 2160, 3840, 2160, AV_PIX_FMT_YUV420P10LE, false);
+	bench("2160p yuv420p10le -> 2160p RGB24 (kernels)", 3840, 2160, 3840, 2160, AV_PIX_FMT_YUV420P10LE, true);
+	bench("1080p nv12 -> 1080p RGB24 (swscale)", 1920, 1080, 1920, 1080, AV_PIX_FMT_NV12, false);
+	bench("1080p nv12 -> 1080p RGB24 (kernels)", 1920, 1080, 1920, 1080, AV_PIX_FMT_NV12, true);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+// Demux throughput: every packet of each file read with all streams enabled,
+// then with all but the best video stream discarded (AVDISCARD_ALL, as
+// Demuxer sets it up). Best of three runs each, from the page cache after
+// the first one. Usage: bench_demux FILE...
+#include "ffmpeg.h"
+#include "test.h"
+#include <ctime>
+#include <cstdio>
+#include <string>
+extern "C" {
+	#include "libavformat/avformat.h"
+}
+
+namespace {
+struct Result {
+	double seconds;
+	double cpu_seconds;
+	size_t packets;
+	size_t bytes;
+};
+
+Result read_all(const std::string& file_name, const bool discard) {
+	AVFormatContext* format_context = nullptr;
+
+	ffmpeg::check(avformat_open_input(&format_context, file_name.c_str(), nullptr, nullptr));
+	ffmpeg::check(avformat_find_stream_info(format_context, nullptr));
+
+	const int video_stream_index = ffmpeg::check(av_find_best_stream(
+		format_context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+
+	if (discard) {
+		for (unsigned i = 0; i < format_context->nb_streams; ++i) {
+			if (static_cast<int>(i) != video_stream_index) {
+				format_context->streams[i]->discard = AVDISCARD_ALL;
+			}
+		}
+	}
+
+	AVPacket* packet = av_packet_alloc();
+	Result result{0.0, 0.0, 0, 0};
+	const std::clock_t cpu_start = std::clock();
+
+	result.seconds = test::best_time(1, [&]() {
+		while (av_read_frame(format_context, packet) >= 0) {
+			++result.packets;
+			result.bytes += packet->size;
+			av_packet_unref(packet);
+		}
+	});
+	result.cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+	av_packet_free(&packet);
+	avformat_close_input(&format_context);
+
+	return result;
+}
+
+void print(const char* name, const Result& result) {
+	printf("  %-16s %8zu packets %9.1f MB %8.3f s (%.3f s CPU) %8.1f MB/s\n", name, result.packets,
+		result.bytes / 1e6, result.seconds, result.cpu_seconds, result.bytes / 1e6 / result.seconds);
+}
+}
+
+int main(int argc, char** argv) {
+	av_log_set_level(AV_LOG_ERROR);
+
+	for (int i = 1; i < argc; ++i) {
+		Result all{1e9, 0.0, 0, 0};
+		Result video_only{1e9, 0.0, 0, 0};
+
+		// alternating, so both see the same cache state
+		for (int run = 0; run < 3; ++run) {
+			const Result first = read_all(argv[i], false);
+			const Result second = read_all(argv[i], true);
+
+			if (first.seconds < all.seconds) {
+				all = first;
+			}
+			if (second.seconds < video_only.seconds) {
+				video_only = second;
+			}
+		}
+
+		printf("%s\n", argv[i]);
+		print("all streams", all);
+		print("video only", video_only);
+		printf("  discarding: %.2fx as fast\n", all.seconds / video_only.seconds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+// Cycles (time stamp counter ticks) and nanoseconds per pixel of every
+// difference kernel the CPU supports: over a 1080p RGB24 frame pair (bound by
+// memory bandwidth) and over one row that stays in the L1 cache (the kernel
+// itself)
+#include "difference.h"
+#include "cpu_features.h"
+#include "test.h"
+#include <cstdio>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+const size_t width = 1920;
+const size_t height = 1080;
+const size_t pitch = width * 3;
+
+struct Timing {
+	double seconds;
+	double cycles;
+};
+
+// Best of 50 runs of height rows, the same row over and over when cached
+Timing run(const DifferenceRowFunction row, const std::vector<uint8_t>& left, const std::vector<uint8_t>& right,
+	std::vector<uint8_t>& diff, const bool cached) {
+	const size_t step = cached ? 0 : pitch;
+	double best_cycles = 1e30;
+	const double seconds = test::best_time(50, [&]() {
+#if defined(__x86_64__) || defined(__i386__)
+		const uint64_t start = __rdtsc();
+#endif
+		for (size_t y = 0; y < height; ++y) {
+			row(&left[y * step], &right[y * step], &diff[y * step], pitch);
+		}
+#if defined(__x86_64__) || defined(__i386__)
+		best_cycles = std::min(best_cycles, static_cast<double>(__rdtsc() - start));
+#endif
+	});
+
+	return {seconds, best_cycles};
+}
+
+void bench(const char* name, const DifferenceRowFunction row, const std::vector<uint8_t>& left,
+	const std::vector<uint8_t>& right, std::vector<uint8_t>& diff) {
+	const double pixels = static_cast<double>(width * height);
+	const Timing frame = run(row, left, right, diff, false);
+	const Timing cached = run(row, left, right, diff, true);
+
+	printf("%-8s frame: %6.3f ms %6.3f ns/pixel %6.3f cycles/pixel   cached row: %6.3f ns/pixel %6.3f cycles/pixel\n",
+		name, frame.seconds * 1000.0, frame.seconds * 1e9 / pixels, frame.cycles / pixels,
+		cached.seconds * 1e9 / pixels, cached.cycles / pixels);
+}
+}
+
+int main() {
+	test::Random random;
+	std::vector<uint8_t> left(pitch * height), right(pitch * height), diff(pitch * height);
+
+	for (size_t i = 0; i < left.size(); ++i) {
+		left[i] = static_cast<uint8_t>(random.next());
+		right[i] = static_cast<uint8_t>(left[i] + random.below(16));
+	}
+
+	printf("CPU features: %s\n", cpu_features_string().c_str());
+	bench("scalar", difference_row_scalar, left, right, diff);
+#if defined(__x86_64__) || defined(__i386__)
+	const CpuFeatures& features = cpu_features();
+
+	if (features.sse2) {
+		bench("SSE2", difference_row_sse2, left, right, diff);
+	}
+	if (features.avx2) {
+		bench("AVX2", difference_row_avx2, left, right, diff);
+	}
+	if (features.avx512bw) {
+		bench("AVX-512", difference_row_avx512, left, right, diff);
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+// One producer and one consumer thread passing items through the SPSC ring
+// of queue.h and through the mutex and condition variable queue it replaced
+// (kept here as the reference), at the depths the pipeline uses
+#include "queue.h"
+#include "test.h"
+#include <cstdio>
+#include <queue>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+const long items = 1000000;
+
+// The pipeline queue before the ring buffer
+template <class T>
+class MutexQueue {
+public:
+	explicit MutexQueue(const size_t size_max) : size_max_{size_max} {
+	}
+
+	bool push(T &&data) {
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		full_.wait(lock, [this] { return queue_.size() < size_max_; });
+		queue_.push(std::move(data));
+		empty_.notify_all();
+		return true;
+	}
+
+	bool pop(T &data) {
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		empty_.wait(lock, [this] { return !queue_.empty() || finished_; });
+		if (queue_.empty()) {
+			return false;
+		}
+		data = std::move(queue_.front());
+		queue_.pop();
+		full_.notify_all();
+		return true;
+	}
+
+	void finished() {
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		finished_ = true;
+		empty_.notify_all();
+	}
+
+private:
+	std::queue<T> queue_;
+	const size_t size_max_;
+	bool finished_{false};
+	std::mutex mutex_;
+	std::condition_variable full_;
+	std::condition_variable empty_;
+};
+
+long context_switches() {
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw + usage.ru_nivcsw;
+#else
+	return 0;
+#endif
+}
+
+template <class Q>
+void bench(const char* name, const size_t depth) {
+	const long switches = context_switches();
+	const double seconds = test::best_time(3, [depth]() {
+		Q queue(depth);
+		std::thread consumer([&queue]() {
+			long item;
+			while (queue.pop(item)) {
+			}
+		});
+
+		for (long i = 0; i < items; ++i) {
+			queue.push(long{i});
+		}
+		queue.finished();
+		consumer.join();
+	});
+
+	printf("  %-14s depth %2zu %7.1f ns/item %6.2f context switches/1000 items\n", name, depth,
+		seconds * 1e9 / items, static_cast<double>(context_switches() - switches) / 3 / (items / 1000));
+}
+}
+
+int main() {
+	printf("%u hardware threads, %ld items\n", std::thread::hardware_concurrency(), items);
+
+	for (const size_t depth : {5, 32}) {
+		bench<MutexQueue<long>>("mutex", depth);
+		bench<Queue<long>>("SPSC ring", depth);
+	}
+
+	return 0;
+}
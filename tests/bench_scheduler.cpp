@@ -0,0 +1,203 @@
+// Two sided demux -> decode -> display pipeline, scheduled like before tasks
+// existed (a blocking thread per stage and side) and like now (tasks on the
+// thread pool, packets_per_step items per step). Stage costs are busy loops:
+// first without any work, which leaves the scheduling overhead, then with a
+// slow and a fast decoder side by side (AV1 next to H.264).
+#include "queue.h"
+#include "task.h"
+#include "thread_pool.h"
+#include "test.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+const int items_per_step = 8;
+
+struct Costs {
+	// Microseconds per item
+	int demux;
+	int decode[2];
+};
+
+void spin(const int microseconds) {
+	const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+
+	while (std::chrono::steady_clock::now() < until) {
+	}
+}
+
+long context_switches() {
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw + usage.ru_nivcsw;
+#else
+	return 0;
+#endif
+}
+
+struct Side {
+	Side() : packets(8, 32), frames(4, 16) {
+	}
+
+	Queue<long> packets;
+	Queue<long> frames;
+};
+
+// The display loop: one frame of each side at a time
+void display(Side sides[2], const long items) {
+	for (long i = 0; i < items; ++i) {
+		long frame;
+
+		sides[0].frames.pop(frame);
+		sides[1].frames.pop(frame);
+	}
+}
+
+void dedicated_threads(const Costs& costs, const long items) {
+	Side sides[2];
+	std::vector<std::thread> threads;
+
+	for (int side = 0; side < 2; ++side) {
+		Side& s = sides[side];
+
+		threads.emplace_back([&s, &costs, items]() {
+			for (long i = 0; i < items; ++i) {
+				spin(costs.demux);
+				s.packets.push(long{i});
+			}
+			s.packets.finished();
+		});
+		threads.emplace_back([&s, &costs, items, side]() {
+			long packet;
+
+			while (s.packets.pop(packet)) {
+				spin(costs.decode[side]);
+				s.frames.push(long{packet});
+			}
+			s.frames.finished();
+		});
+	}
+
+	display(sides, items);
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void pool_tasks(const Costs& costs, const long items) {
+	ThreadPool pool(1, 4);
+	Side sides[2];
+
+	struct State {
+		long demuxed{0};
+		long packet{0};
+		bool has_packet{false};
+		long frame{0};
+		bool has_frame{false};
+	} states[2];
+
+	std::vector<std::unique_ptr<Task>> tasks;
+
+	for (int side = 0; side < 2; ++side) {
+		Side& s = sides[side];
+		State& state = states[side];
+
+		tasks.push_back(std::make_unique<Task>(pool, [&s, &state, &costs, items]() {
+			for (int i = 0; i < items_per_step; ++i) {
+				if (!state.has_packet) {
+					if (state.demuxed == items) {
+						s.packets.finished();
+						return Task::Status::done;
+					}
+					spin(costs.demux);
+					state.packet = state.demuxed++;
+					state.has_packet = true;
+				}
+				if (s.packets.try_push(state.packet) == QueueStatus::would_block) {
+					return Task::Status::blocked;
+				}
+				state.has_packet = false;
+			}
+			return Task::Status::progress;
+		}));
+		tasks.push_back(std::make_unique<Task>(pool, [&s, &state, &costs, side]() {
+			for (int i = 0; i < items_per_step; ++i) {
+				if (state.has_frame) {
+					if (s.frames.try_push(state.frame) == QueueStatus::would_block) {
+						return Task::Status::blocked;
+					}
+					state.has_frame = false;
+				}
+
+				uint64_t epoch;
+				switch (s.packets.try_pop(state.frame, epoch)) {
+				case QueueStatus::would_block:
+					return Task::Status::blocked;
+				case QueueStatus::closed:
+					s.frames.finished();
+					return Task::Status::done;
+				case QueueStatus::done:
+					break;
+				}
+				spin(costs.decode[side]);
+				state.has_frame = true;
+			}
+			return Task::Status::progress;
+		}));
+	}
+
+	Task& demux_0 = *tasks[0];
+	Task& decode_0 = *tasks[1];
+	Task& demux_1 = *tasks[2];
+	Task& decode_1 = *tasks[3];
+	sides[0].packets.set_wake([&demux_0]() { demux_0.wake(); }, [&decode_0]() { decode_0.wake(); });
+	sides[0].frames.set_wake([&decode_0]() { decode_0.wake(); }, nullptr);
+	sides[1].packets.set_wake([&demux_1]() { demux_1.wake(); }, [&decode_1]() { decode_1.wake(); });
+	sides[1].frames.set_wake([&decode_1]() { decode_1.wake(); }, nullptr);
+
+	for (auto& task : tasks) {
+		task->start();
+	}
+
+	display(sides, items);
+
+	for (auto& task : tasks) {
+		task->wait();
+	}
+}
+
+template <class Pipeline>
+void bench(const char* name, Pipeline pipeline, const Costs& costs, const long items) {
+	const long switches = context_switches();
+	const std::clock_t cpu_start = std::clock();
+	const double seconds = test::best_time(1, [&]() { pipeline(costs, items); });
+	const double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+	printf("  %-18s %9.0f frame pairs/s %8.2f us/pair (%.2f us CPU) %9.1f context switches/pair\n", name,
+		items / seconds, seconds * 1e6 / items, cpu_seconds * 1e6 / items,
+		static_cast<double>(context_switches() - switches) / items);
+}
+}
+
+int main() {
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+	const Costs none{0, {0, 0}};
+	printf("no work, 200000 frames per side\n");
+	bench("dedicated threads", dedicated_threads, none, 200000);
+	bench("pool tasks", pool_tasks, none, 200000);
+
+	// per frame: demux 5 us, decode 400 us (AV1) and 100 us (H.264)
+	const Costs asymmetric{5, {400, 100}};
+	printf("AV1 next to H.264, 2000 frames per side\n");
+	bench("dedicated threads", dedicated_threads, asymmetric, 2000);
+	bench("pool tasks", pool_tasks, asymmetric, 2000);
+
+	return 0;
+}
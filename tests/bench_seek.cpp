@@ -0,0 +1,212 @@
+// Seek latency, from the request to the first frame of the new position and
+// to the first frame at the target, through the seek handshake of the player:
+// a seek raises the epoch and flushes both queues, the demux thread seeks
+// when it sees the new epoch, the decoder flushes on the first packet of it,
+// and stale packets and frames are dropped on the way. Random accurate seeks
+// (keyframe before the target, decoded up to it), without and with the
+// packet index, 100 of each per file. A seek that reaches the end of the file
+// before the target is counted as such and ends there. Usage: bench_seek
+// FILE...
+#include "demuxer.h"
+#include "packet_index.h"
+#include "queue.h"
+#include "video_decoder.h"
+#include "test.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using PacketPointer = std::unique_ptr<AVPacket, std::function<void(AVPacket*)>>;
+using FramePointer = std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>;
+
+double milliseconds(const Clock::duration duration) {
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void print(const char* name, std::vector<double> values) {
+	if (values.empty()) {
+		return;
+	}
+	std::sort(values.begin(), values.end());
+
+	auto percentile = [&values](const double p) {
+		return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+	};
+
+	printf("  %-14s p50 %7.2f ms  p95 %7.2f ms  max %7.2f ms\n", name, percentile(0.5), percentile(0.95), values.back());
+}
+
+void bench(const char* file_name, const bool build_index, const int seeks) {
+	Demuxer demuxer(file_name, build_index);
+	VideoDecoder decoder(demuxer.video_codec_parameters());
+	Queue<PacketPointer> packets(32);
+	Queue<FramePointer> frames(8);
+
+	std::atomic<uint64_t> seek_epoch{0};
+	std::mutex seek_mutex;
+	float seek_position = 0.0f;
+	std::atomic<bool> quit{false};
+	std::vector<double> demuxer_seeks;
+
+	std::thread demux([&]() {
+		uint64_t epoch = 0;
+		bool at_end = false;
+
+		while (!quit) {
+			if (seek_epoch != epoch) {
+				float position;
+				{
+					std::lock_guard<std::mutex> lock(seek_mutex);
+					epoch = seek_epoch;
+					position = seek_position;
+				}
+
+				const auto started = Clock::now();
+				demuxer.seek(position, true);
+				demuxer_seeks.push_back(milliseconds(Clock::now() - started));
+				at_end = false;
+			}
+			if (at_end) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			PacketPointer packet{av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); }};
+
+			if (!demuxer(*packet)) {
+				// an empty packet marks the end of the file
+				packets.push(PacketPointer{}, epoch);
+				at_end = true;
+			} else if (packet->stream_index == demuxer.video_stream_index()) {
+				packets.push(std::move(packet), epoch);
+			}
+		}
+	});
+
+	std::thread decode([&]() {
+		uint64_t decoder_epoch = 0;
+		PacketPointer packet;
+		uint64_t epoch;
+
+		while (packets.pop(packet, epoch)) {
+			if (epoch != decoder_epoch) {
+				decoder.flush();
+				decoder_epoch = epoch;
+			}
+
+			// an empty packet drains the decoder, then ends the epoch's frames
+			decoder.send(packet.get());
+
+			for (;;) {
+				FramePointer frame{av_frame_alloc(), [](AVFrame* f) { av_frame_free(&f); }};
+
+				if (!decoder.receive(frame.get())) {
+					break;
+				}
+				frames.push(std::move(frame), epoch);
+			}
+			if (!packet) {
+				frames.push(FramePointer{}, epoch);
+			}
+		}
+	});
+
+	const float duration = demuxer.duration() / static_cast<float>(AV_TIME_BASE);
+	const AVRational microseconds = {1, 1000000};
+	std::vector<double> first_frames, at_targets;
+	int at_ends = 0;
+
+	srand(1);
+
+	for (int seek = 0; seek < seeks; ++seek) {
+		const float position = duration * 0.9f * static_cast<float>(rand()) / RAND_MAX;
+		const int64_t target = static_cast<int64_t>(position * 1000000.0);
+		const auto requested = Clock::now();
+		uint64_t epoch;
+		{
+			std::lock_guard<std::mutex> lock(seek_mutex);
+			epoch = ++seek_epoch;
+			seek_position = position;
+		}
+		packets.flush(epoch);
+		frames.flush(epoch);
+
+		bool first = true;
+		FramePointer frame;
+		uint64_t frame_epoch;
+
+		while (frames.pop(frame, frame_epoch)) {
+			if (frame_epoch != epoch) {
+				continue;
+			}
+			if (!frame) {
+				++at_ends;
+				break;
+			}
+			if (first) {
+				first_frames.push_back(milliseconds(Clock::now() - requested));
+				first = false;
+			}
+			// frames carry the time stamps of their packets, in the stream
+			// time base, like in the player
+			if (frame->pkt_dts != AV_NOPTS_VALUE &&
+				av_rescale_q(frame->pkt_dts, demuxer.time_base(), microseconds) >= target - 1000) {
+				at_targets.push_back(milliseconds(Clock::now() - requested));
+				break;
+			}
+		}
+	}
+
+	quit = true;
+	packets.quit();
+	frames.quit();
+	demux.join();
+	decode.join();
+
+	printf("%s, %d seeks, %s\n", file_name, seeks, build_index ? "packet index" : "no packet index");
+	print("demuxer seek", demuxer_seeks);
+	print("first frame", first_frames);
+	print("at target", at_targets);
+	if (at_ends > 0) {
+		printf("  %d seek(s) reached the end of the file before the target\n", at_ends);
+	}
+}
+
+// The demuxer loads a cached index right away; build it here first (gives
+// up after a minute, or when the input cannot be indexed)
+bool build_index(const char* file_name) {
+	Demuxer demuxer(file_name, false);
+	PacketIndex index(file_name, demuxer.video_stream_index());
+
+	for (int wait = 0; wait < 6000 && !index.ready(); ++wait) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	return index.ready();
+}
+}
+
+int main(int argc, char** argv) {
+	const int seeks = 100;
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	for (int i = 1; i < argc; ++i) {
+		bench(argv[i], false, seeks);
+
+		if (build_index(argv[i])) {
+			bench(argv[i], true, seeks);
+		} else {
+			printf("no packet index for %s\n", argv[i]);
+		}
+	}
+
+	return 0;
+}
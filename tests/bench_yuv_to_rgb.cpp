@@ -0,0 +1,144 @@
+// Same-size 1080p conversion to RGB24 of every layout with a kernel: scalar,
+// AVX2 and swscale (bicubic, BT.709 limited range, as FormatConverter sets it
+// up), all on one thread. Also how far the kernels' nearest sample chroma
+// lands from swscale's interpolated chroma, on a smooth test picture.
+#include "yuv_to_rgb.h"
+#include "cpu_features.h"
+#include "test.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+extern "C" {
+	#include "libswscale/swscale.h"
+}
+
+namespace {
+const int width = 1920;
+const int height = 1080;
+
+struct Picture {
+	std::vector<uint8_t> planes[3];
+	int linesizes[3]{};
+};
+
+// 8-bit sample at (x, y) of a plane: smooth gradients with some detail
+uint8_t sample(const int plane, const int x, const int y) {
+	switch (plane) {
+	case 0:
+		return static_cast<uint8_t>(126 + 90 * std::sin(x / 41.0) * std::cos(y / 29.0) + 8 * std::sin(x / 3.0 + y / 5.0));
+	case 1:
+		return static_cast<uint8_t>(128 + 60 * std::sin(x / 23.0 + y / 31.0));
+	default:
+		return static_cast<uint8_t>(128 + 60 * std::cos(x / 37.0 - y / 19.0));
+	}
+}
+
+template <YuvLayout Layout>
+Picture picture() {
+	const bool ten_bit = Layout == YuvLayout::yuv420p10 || Layout == YuvLayout::p010;
+	const bool semi_planar = Layout == YuvLayout::nv12 || Layout == YuvLayout::p010;
+	const int bytes = ten_bit ? 2 : 1;
+	Picture picture;
+
+	picture.linesizes[0] = width * bytes;
+	picture.linesizes[1] = semi_planar ? width * bytes : width / 2 * bytes;
+	picture.linesizes[2] = semi_planar ? 0 : width / 2 * bytes;
+
+	for (int plane = 0; plane < 3; ++plane) {
+		picture.planes[plane].resize(picture.linesizes[plane] * (plane == 0 ? height : height / 2));
+	}
+
+	auto store = [&](const int plane, const size_t index, const uint8_t value) {
+		if (Layout == YuvLayout::yuv420p10) {
+			reinterpret_cast<uint16_t*>(picture.planes[plane].data())[index] = static_cast<uint16_t>(value << 2);
+		} else if (Layout == YuvLayout::p010) {
+			reinterpret_cast<uint16_t*>(picture.planes[plane].data())[index] = static_cast<uint16_t>(value << 8);
+		} else {
+			picture.planes[plane][index] = value;
+		}
+	};
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			store(0, y * width + x, sample(0, x, y));
+		}
+	}
+	for (int y = 0; y < height / 2; ++y) {
+		for (int x = 0; x < width / 2; ++x) {
+			if (semi_planar) {
+				store(1, y * width + 2 * x, sample(1, 2 * x, 2 * y));
+				store(1, y * width + 2 * x + 1, sample(2, 2 * x, 2 * y));
+			} else {
+				store(1, y * width / 2 + x, sample(1, 2 * x, 2 * y));
+				store(2, y * width / 2 + x, sample(2, 2 * x, 2 * y));
+			}
+		}
+	}
+
+	return picture;
+}
+
+template <YuvLayout Layout>
+void convert(const YuvToRgbRowFunction row, const Picture& picture, std::vector<uint8_t>& rgb) {
+	const YuvToRgbCoefficients coefficients = yuv_to_rgb_coefficients(YuvMatrix::bt709, false);
+	const bool semi_planar = Layout == YuvLayout::nv12 || Layout == YuvLayout::p010;
+
+	for (int y = 0; y < height; ++y) {
+		row(picture.planes[0].data() + y * picture.linesizes[0],
+			picture.planes[1].data() + (y / 2) * picture.linesizes[1],
+			semi_planar ? nullptr : picture.planes[2].data() + (y / 2) * picture.linesizes[2],
+			rgb.data() + y * width * 3, width, coefficients);
+	}
+}
+
+template <YuvLayout Layout>
+void bench(const char* name, const AVPixelFormat format) {
+	const Picture source = picture<Layout>();
+	std::vector<uint8_t> kernel_rgb(width * height * 3), sws_rgb(width * height * 3);
+	const double scalar = test::best_time(10, [&]() { convert<Layout>(yuv_to_rgb_row_scalar<Layout>, source, kernel_rgb); });
+	double avx2 = 0.0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (cpu_features().avx2) {
+		avx2 = test::best_time(10, [&]() { convert<Layout>(yuv_to_rgb_row_avx2<Layout>, source, kernel_rgb); });
+	}
+#endif
+
+	SwsContext* context = sws_getContext(width, height, format, width, height, AV_PIX_FMT_RGB24, SWS_BICUBIC, nullptr, nullptr, nullptr);
+	const int* coefficients = sws_getCoefficients(SWS_CS_ITU709);
+	sws_setColorspaceDetails(context, coefficients, 0, coefficients, 1, 0, 1 << 16, 1 << 16);
+
+	const uint8_t* const src_data[4] = {source.planes[0].data(), source.planes[1].data(),
+		source.linesizes[2] != 0 ? source.planes[2].data() : nullptr, nullptr};
+	const int src_linesizes[4] = {source.linesizes[0], source.linesizes[1], source.linesizes[2], 0};
+	uint8_t* const dst_data[4] = {sws_rgb.data(), nullptr, nullptr, nullptr};
+	const int dst_linesizes[4] = {width * 3, 0, 0, 0};
+	const double swscale = test::best_time(10, [&]() {
+		sws_scale(context, src_data, src_linesizes, 0, height, dst_data, dst_linesizes);
+	});
+	sws_freeContext(context);
+
+	// kernel_rgb holds the last kernel's output
+	int max_difference = 0;
+	double total_difference = 0.0;
+	for (size_t i = 0; i < kernel_rgb.size(); ++i) {
+		const int difference = std::abs(kernel_rgb[i] - sws_rgb[i]);
+
+		max_difference = std::max(max_difference, difference);
+		total_difference += difference;
+	}
+
+	printf("%-12s scalar %6.2f ms  AVX2 %6.2f ms  swscale %6.2f ms  |kernel - swscale| mean %.2f max %d\n",
+		name, scalar * 1000.0, avx2 * 1000.0, swscale * 1000.0, total_difference / kernel_rgb.size(), max_difference);
+}
+}
+
+int main() {
+	printf("CPU features: %s\n", cpu_features_string().c_str());
+	bench<YuvLayout::yuv420p>("yuv420p", AV_PIX_FMT_YUV420P);
+	bench<YuvLayout::nv12>("nv12", AV_PIX_FMT_NV12);
+	bench<YuvLayout::yuv420p10>("yuv420p10le", AV_PIX_FMT_YUV420P10LE);
+	bench<YuvLayout::p010>("p010le", AV_PIX_FMT_P010LE);
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Minimal support for the unit tests and benchmarks in this directory (built
+// by make check / make bench). A failing CHECK is reported and makes the test
+// exit with 1.
+namespace test {
+inline int &failures() {
+	static int count = 0;
+
+	return count;
+}
+
+inline int exit_code() {
+	if (failures() > 0) {
+		std::cerr << failures() << " check(s) failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Deterministic, so a failure reproduces
+class Random {
+public:
+	explicit Random(const uint64_t seed = 0x9e3779b97f4a7c15) : state_{seed} {
+	}
+
+	uint64_t next() {
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 7;
+		state_ ^= state_ << 17;
+		return state_;
+	}
+
+	// In [0, bound)
+	size_t below(const size_t bound) {
+		return static_cast<size_t>(next() % bound);
+	}
+
+private:
+	uint64_t state_;
+};
+
+// Best of several runs of a function, in seconds
+template <class Function>
+double best_time(const int runs, Function function) {
+	double best = 1e9;
+
+	for (int run = 0; run < runs; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+			++test::failures(); \
+		} \
+	} while (false)
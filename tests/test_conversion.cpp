@@ -0,0 +1,94 @@
+// Sliced conversions (one swscale context per thread, each writing its band
+// of output rows) against a single sws_scale() call, and the YUV kernels in
+// bands of rows against one call over the whole picture: the RGB24 pictures
+// have to be identical, scaled and same-size, for 2, 3 and 8 threads
+#include "format_converter.h"
+#include "ffmpeg.h"
+#include "thread_pool.h"
+#include "test.h"
+#include <cstring>
+#include <functional>
+#include <memory>
+
+namespace {
+using FramePointer = std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>;
+
+FramePointer allocate(const int width, const int height, const AVPixelFormat format) {
+	FramePointer frame{av_frame_alloc(), [](AVFrame* f) { av_frame_free(&f); }};
+
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	frame->colorspace = AVCOL_SPC_BT709;
+	frame->color_range = AVCOL_RANGE_MPEG;
+	ffmpeg::check(av_frame_get_buffer(frame.get(), 0));
+
+	return frame;
+}
+
+// Random samples (10-bit ones in range)
+void fill(AVFrame* frame, test::Random& random) {
+	const bool ten_bit = frame->format == AV_PIX_FMT_YUV420P10LE;
+
+	for (int plane = 0; plane < AV_NUM_DATA_POINTERS && frame->buf[plane] != nullptr; ++plane) {
+		for (size_t i = 0; i < frame->buf[plane]->size; ++i) {
+			frame->buf[plane]->data[i] = static_cast<uint8_t>(random.next() & (ten_bit && i % 2 == 1 ? 3 : 0xff));
+		}
+	}
+}
+
+bool same_picture(const AVFrame* a, const AVFrame* b) {
+	for (int row = 0; row < a->height; ++row) {
+		if (memcmp(a->data[0] + row * a->linesize[0], b->data[0] + row * b->linesize[0], a->width * 3) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void check(const char* name, const int src_width, const int src_height, const int dest_width, const int dest_height,
+	const AVPixelFormat format, const bool use_kernels, test::Random& random) {
+	FramePointer src = allocate(src_width, src_height, format);
+	FramePointer expected = allocate(dest_width, dest_height, AV_PIX_FMT_RGB24);
+	FramePointer actual = allocate(dest_width, dest_height, AV_PIX_FMT_RGB24);
+
+	fill(src.get(), random);
+
+	FormatConverter single(src_width, src_height, dest_width, dest_height, format, AV_PIX_FMT_RGB24, nullptr,
+		use_kernels);
+	single(src.get(), expected.get());
+
+	for (const size_t threads : {2, 3, 8}) {
+		ThreadPool pool(threads);
+		FormatConverter sliced(src_width, src_height, dest_width, dest_height, format, AV_PIX_FMT_RGB24, &pool,
+			use_kernels);
+
+		memset(actual->buf[0]->data, 0xa5, actual->buf[0]->size);
+		sliced(src.get(), actual.get());
+
+		if (!same_picture(actual.get(), expected.get())) {
+			std::cerr << name << ": " << threads << " threads differ from a single conversion" << std::endl;
+			CHECK(same_picture(actual.get(), expected.get()));
+			return;
+		}
+	}
+	std::cout << name << ": checked" << std::endl;
+}
+}
+
+int main() {
+	test::Random random;
+
+	// odd sizes, so the last slice is a short one
+	check("yuv420p 1280x722 -> 853x481", 1280, 722, 853, 481, AV_PIX_FMT_YUV420P, true, random);
+	check("yuv420p10le 1280x722 -> 1921x1083", 1280, 722, 1921, 1083, AV_PIX_FMT_YUV420P10LE, true, random);
+	check("yuv422p 1280x722", 1280, 722, 1280, 722, AV_PIX_FMT_YUV422P, true, random);
+	check("yuv444p 1280x722", 1280, 722, 1280, 722, AV_PIX_FMT_YUV444P, true, random);
+	// same-size 4:2:0, through swscale and through the kernels
+	check("yuv420p 1280x722 (swscale)", 1280, 722, 1280, 722, AV_PIX_FMT_YUV420P, false, random);
+	check("yuv420p 1280x722 (kernels)", 1280, 722, 1280, 722, AV_PIX_FMT_YUV420P, true, random);
+	check("yuv420p10le 1280x722 (kernels)", 1280, 722, 1280, 722, AV_PIX_FMT_YUV420P10LE, true, random);
+
+	return test::exit_code();
+}
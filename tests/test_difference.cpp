@@ -0,0 +1,103 @@
+// Every difference kernel the CPU supports against the scalar reference,
+// over random widths (all tail lengths), alignments and pitches
+#include "difference.h"
+#include "cpu_features.h"
+#include "test.h"
+#include <vector>
+
+namespace {
+struct Kernel {
+	const char* name;
+	DifferenceRowFunction function;
+	bool supported;
+};
+
+std::vector<Kernel> kernels() {
+	std::vector<Kernel> all;
+#if defined(__x86_64__) || defined(__i386__)
+	const CpuFeatures& features = cpu_features();
+
+	all.push_back({"SSE2", difference_row_sse2, features.sse2});
+	all.push_back({"AVX2", difference_row_avx2, features.avx2});
+	all.push_back({"AVX-512", difference_row_avx512, features.avx512bw});
+#endif
+	return all;
+}
+
+void fill(std::vector<uint8_t>& bytes, test::Random& random) {
+	for (auto& byte : bytes) {
+		// mostly close values (the interesting range), some extremes
+		byte = random.below(4) == 0 ? (random.below(2) ? 0 : 255) : static_cast<uint8_t>(random.below(256));
+	}
+}
+
+void check_rows(const Kernel& kernel, test::Random& random) {
+	std::vector<uint8_t> left(4096 + 64), right(4096 + 64), expected(4096 + 64), actual(4096 + 64);
+
+	for (int round = 0; round < 2000; ++round) {
+		const size_t bytes = random.below(round < 300 ? 300 : 4096);
+		const size_t offset = random.below(64);
+
+		fill(left, random);
+		fill(right, random);
+		// neighbours of the row must stay untouched
+		std::fill(expected.begin(), expected.end(), 0xa5);
+		std::fill(actual.begin(), actual.end(), 0xa5);
+
+		difference_row_scalar(left.data() + offset, right.data() + offset, expected.data() + offset, bytes);
+		kernel.function(left.data() + offset, right.data() + offset, actual.data() + offset, bytes);
+
+		if (actual != expected) {
+			std::cerr << kernel.name << ": mismatch for " << bytes << " bytes at offset " << offset << std::endl;
+			CHECK(actual == expected);
+			return;
+		}
+	}
+}
+
+// The dispatched frame function, with pitches larger than the rows
+void check_frame(test::Random& random) {
+	for (int round = 0; round < 50; ++round) {
+		const size_t row_bytes = 3 * (1 + random.below(700));
+		const size_t rows = 1 + random.below(40);
+		const size_t pitches[3] = {row_bytes + random.below(64), row_bytes + random.below(64), row_bytes + random.below(64)};
+		std::vector<uint8_t> left(pitches[0] * rows), right(pitches[1] * rows), diff(pitches[2] * rows, 0xa5);
+
+		fill(left, random);
+		fill(right, random);
+		difference(left.data(), pitches[0], right.data(), pitches[1], diff.data(), pitches[2], row_bytes, rows);
+
+		for (size_t y = 0; y < rows; ++y) {
+			std::vector<uint8_t> expected(row_bytes);
+			difference_row_scalar(&left[y * pitches[0]], &right[y * pitches[1]], expected.data(), row_bytes);
+
+			CHECK(std::equal(expected.begin(), expected.end(), diff.begin() + y * pitches[2]));
+			CHECK(std::all_of(diff.begin() + y * pitches[2] + row_bytes, diff.begin() + (y + 1) * pitches[2],
+				[](const uint8_t byte) { return byte == 0xa5; }));
+		}
+	}
+}
+}
+
+int main() {
+	test::Random random;
+
+	// the reference itself
+	const uint8_t left[4] = {0, 255, 100, 7};
+	const uint8_t right[4] = {255, 0, 90, 200};
+	uint8_t diff[4];
+	difference_row_scalar(left, right, diff, 4);
+	CHECK(diff[0] == 255 && diff[1] == 255 && diff[2] == 20 && diff[3] == 255);
+
+	for (const Kernel& kernel : kernels()) {
+		if (!kernel.supported) {
+			std::cout << kernel.name << ": not supported by this CPU, skipped" << std::endl;
+			continue;
+		}
+		check_rows(kernel, random);
+		std::cout << kernel.name << ": checked" << std::endl;
+	}
+	check_frame(random);
+
+	return test::exit_code();
+}
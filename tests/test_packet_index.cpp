@@ -0,0 +1,134 @@
+// Loading of the packet index cache: a cache matching the input is used as
+// is, one whose entry count does not match its length (corrupt, truncated)
+// is rejected without allocating for the bogus count
+#include "packet_index.h"
+#include "test.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// The input and its cache live in a directory of their own under the system
+// temporary directory, removed again when the test ends
+class TemporaryDirectory {
+public:
+	TemporaryDirectory() {
+		const char* parent = std::getenv("TMPDIR");
+		std::string name = std::string(parent != nullptr && *parent != '\0' ? parent : "/tmp") + "/video-compare.XXXXXX";
+
+		if (mkdtemp(&name[0]) != nullptr) {
+			path_ = name;
+		}
+	}
+	~TemporaryDirectory() {
+		if (!path_.empty()) {
+			for (const auto &file : files_) {
+				std::remove(file.c_str());
+			}
+			rmdir(path_.c_str());
+		}
+	}
+
+	bool created() const {
+		return !path_.empty();
+	}
+
+	// Path of a file in the directory, removed along with it
+	std::string file(const std::string &name) {
+		files_.push_back(path_ + "/" + name);
+		return files_.back();
+	}
+
+private:
+	std::string path_;
+	std::vector<std::string> files_;
+};
+
+std::string input_name;
+std::string cache_name;
+
+// Layout of the cache file (see packet_index.cpp)
+struct CacheHeader {
+	char magic[8];
+	int64_t file_size;
+	int64_t file_mtime;
+	int32_t stream_index;
+	int32_t entry_size;
+	uint64_t entry_count;
+};
+
+void write_cache(const uint64_t entry_count, const std::vector<PacketIndexEntry>& entries) {
+	struct stat input_status;
+	stat(input_name.c_str(), &input_status);
+
+	CacheHeader header;
+	memcpy(header.magic, "VCIDX001", sizeof(header.magic));
+	header.file_size = input_status.st_size;
+	header.file_mtime = input_status.st_mtime;
+	header.stream_index = 0;
+	header.entry_size = sizeof(PacketIndexEntry);
+	header.entry_count = entry_count;
+
+	std::ofstream file(cache_name, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PacketIndexEntry));
+}
+
+// The cache is rejected: nothing loaded, and rebuilding from the input (not
+// a video) fails too
+void check_rejected(const uint64_t entry_count, const std::vector<PacketIndexEntry>& entries) {
+	write_cache(entry_count, entries);
+
+	PacketIndex index(input_name, 0);
+	index.wait();
+	CHECK(!index.ready());
+	CHECK(index.size() == 0);
+}
+}
+
+int main() {
+	TemporaryDirectory directory;
+
+	if (!directory.created()) {
+		std::cerr << "cannot create a temporary directory" << std::endl;
+		return 1;
+	}
+	input_name = directory.file("packet_index_test.data");
+	cache_name = directory.file("packet_index_test.data.vcidx");
+
+	{
+		std::ofstream input(input_name, std::ios::binary | std::ios::trunc);
+		input << std::string(4096, '\0');
+	}
+
+	const std::vector<PacketIndexEntry> entries = {
+		{0, 0, 0, 100, AV_PKT_FLAG_KEY},
+		{100, 100, 100, 50, 0},
+		{200, 200, 150, 100, AV_PKT_FLAG_KEY}};
+
+	write_cache(entries.size(), entries);
+	{
+		PacketIndex index(input_name, 0);
+		PacketIndexEntry keyframe;
+
+		CHECK(index.ready());
+		CHECK(index.size() == entries.size());
+		CHECK(index.keyframe_before(150, keyframe) && keyframe.pts == 0);
+		CHECK(index.keyframe_after(150, keyframe) && keyframe.pts == 200);
+	}
+
+	check_rejected(uint64_t(1) << 60, entries);
+	check_rejected(UINT64_MAX, entries);
+	check_rejected(entries.size() + 1, entries);
+	check_rejected(entries.size() - 1, entries);
+	check_rejected(0, entries);
+
+	std::cout << "cache loading: checked" << std::endl;
+
+	return test::exit_code();
+}
@@ -0,0 +1,186 @@
+// Producer/consumer stress test of the SPSC ring in queue.h: items arrive
+// once and in order through wrap-arounds and blocking on both sides, the byte
+// budget and adaptive depth hold, flushed epochs never come out again, and
+// the non-blocking calls agree with the blocking ones
+#include "queue.h"
+#include "test.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+const long items = 200000;
+
+void check_order() {
+	Queue<long> queue(3);
+	long value = 0;
+	bool ordered = true;
+
+	std::thread consumer([&]() {
+		long item;
+		while (queue.pop(item)) {
+			ordered = ordered && item == value;
+			++value;
+		}
+	});
+
+	for (long i = 0; i < items; ++i) {
+		queue.push(long{i});
+	}
+	queue.finished();
+	consumer.join();
+
+	CHECK(ordered);
+	CHECK(value == items);
+	CHECK(queue.size() == 0);
+}
+
+void check_limits() {
+	const size_t bytes_max = 1000;
+	Queue<long> queue(2, 16, bytes_max, [](const long &item) { return static_cast<size_t>(item % 300 + 1); });
+	long value = 0;
+	bool ordered = true;
+	bool within = true;
+
+	std::thread consumer([&]() {
+		long item;
+		while (queue.pop(item)) {
+			ordered = ordered && item == value;
+			++value;
+
+			// snapshots: the budget may only be exceeded by a single item
+			within = within && queue.depth() >= 2 && queue.depth() <= 16 && queue.bytes() < bytes_max + 300;
+			if (value % 1000 == 0) {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (long i = 0; i < items; ++i) {
+		queue.push(long{i});
+	}
+	queue.finished();
+	consumer.join();
+
+	CHECK(ordered);
+	CHECK(within);
+	CHECK(value == items);
+	CHECK(queue.bytes() == 0);
+}
+
+void check_flush() {
+	Queue<long> queue(4, 16);
+	std::atomic<uint64_t> epoch{0};
+	// raised once the queue has been flushed to it
+	std::atomic<uint64_t> flushed{0};
+	std::atomic<bool> producing{true};
+	long popped = 0;
+	bool valid = true;
+
+	std::thread consumer([&]() {
+		long item, last = -1;
+		uint64_t item_epoch, last_epoch = 0;
+
+		for (;;) {
+			const uint64_t oldest = flushed;
+
+			if (!queue.pop(item, item_epoch)) {
+				break;
+			}
+			valid = valid && item > last && item_epoch >= last_epoch && item_epoch >= oldest;
+			last = item;
+			last_epoch = item_epoch;
+			++popped;
+		}
+	});
+
+	std::thread flusher([&]() {
+		while (producing) {
+			for (int i = 0; i < 100; ++i) {
+				std::this_thread::yield();
+			}
+			queue.flush(++epoch);
+			flushed = epoch.load();
+		}
+	});
+
+	for (long i = 0; i < items; ++i) {
+		queue.push(long{i}, epoch);
+	}
+	producing = false;
+	flusher.join();
+	queue.finished();
+	consumer.join();
+
+	CHECK(valid);
+	CHECK(popped > 0 && popped <= items);
+	CHECK(queue.size() == 0);
+}
+
+void check_non_blocking() {
+	Queue<long> queue(5);
+	long value = 0;
+	bool ordered = true;
+
+	std::thread consumer([&]() {
+		for (;;) {
+			long item;
+			uint64_t epoch;
+			const QueueStatus status = queue.try_pop(item, epoch);
+
+			if (status == QueueStatus::closed) {
+				break;
+			}
+			if (status == QueueStatus::would_block) {
+				std::this_thread::yield();
+				continue;
+			}
+			ordered = ordered && item == value;
+			++value;
+		}
+	});
+
+	for (long i = 0; i < items;) {
+		long item = i;
+
+		if (queue.try_push(item) == QueueStatus::done) {
+			++i;
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	queue.finished();
+	consumer.join();
+
+	CHECK(ordered);
+	CHECK(value == items);
+}
+
+void check_quit() {
+	Queue<long> queue(2);
+	std::thread producer([&]() {
+		long i = 0;
+		while (queue.push(long{i++})) {
+		}
+	});
+
+	long item;
+	CHECK(queue.pop(item) && item == 0);
+	queue.quit();
+	producer.join();
+
+	long other = 1;
+	CHECK(!queue.push(long{other}));
+	CHECK(!queue.pop(item));
+}
+}
+
+int main() {
+	check_order();
+	check_limits();
+	check_flush();
+	check_non_blocking();
+	check_quit();
+	std::cout << "order, limits, flush, non-blocking calls and quit: checked" << std::endl;
+
+	return test::exit_code();
+}
@@ -0,0 +1,178 @@
+// Stress test of the pipeline scheduling: a producer and a relay task on a
+// ThreadPool, chained by two small queues through try_push()/try_pop() and
+// wake hooks, feeding a consumer that blocks in pop(). Every item has to
+// arrive exactly once and in order, while the tasks and the consumer run
+// nested batches on the same pool. Also: exceptions thrown by a batch, and
+// batch bookkeeping being recycled instead of allocated per run().
+#include "queue.h"
+#include "task.h"
+#include "thread_pool.h"
+#include "test.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+const long items = 20000;
+const int items_per_step = 8;
+
+void check_pipeline(const size_t threads) {
+	ThreadPool pool(threads, 4);
+	Queue<long> first(2, 16);
+	Queue<long> second(2, 8);
+	std::atomic<long> batch_sum{0};
+	bool ordered = true;
+
+	// producer state
+	long produced = 0;
+	long pending = 0;
+	bool has_pending = false;
+
+	Task producer(pool, [&]() {
+		for (int i = 0; i < items_per_step; ++i) {
+			if (!has_pending) {
+				if (produced == items) {
+					first.finished();
+					return Task::Status::done;
+				}
+				pending = produced++;
+				has_pending = true;
+			}
+			switch (first.try_push(pending, 0)) {
+			case QueueStatus::would_block:
+				return Task::Status::blocked;
+			case QueueStatus::closed:
+				return Task::Status::done;
+			case QueueStatus::done:
+				has_pending = false;
+				break;
+			}
+		}
+		return Task::Status::progress;
+	});
+
+	// relay state
+	long relayed = 0;
+	long held = 0;
+	bool holding = false;
+
+	Task relay(pool, [&]() {
+		for (int i = 0; i < items_per_step; ++i) {
+			if (holding) {
+				switch (second.try_push(held, 0)) {
+				case QueueStatus::would_block:
+					return Task::Status::blocked;
+				case QueueStatus::closed:
+					return Task::Status::done;
+				case QueueStatus::done:
+					holding = false;
+					break;
+				}
+			}
+
+			uint64_t epoch;
+			switch (first.try_pop(held, epoch)) {
+			case QueueStatus::would_block:
+				return Task::Status::blocked;
+			case QueueStatus::closed:
+				second.finished();
+				return Task::Status::done;
+			case QueueStatus::done:
+				break;
+			}
+			ordered = ordered && held == relayed;
+			++relayed;
+			holding = true;
+
+			if (held % 97 == 0) {
+				pool.run(7, [&](size_t k) { batch_sum += k; });
+			}
+		}
+		return Task::Status::progress;
+	});
+
+	first.set_wake([&]() { producer.wake(); }, [&]() { relay.wake(); });
+	second.set_wake([&]() { relay.wake(); }, nullptr);
+	producer.start();
+	relay.start();
+
+	long item, expected = 0;
+	while (second.pop(item)) {
+		CHECK(item == expected);
+		if (item != expected) {
+			break;
+		}
+		++expected;
+
+		if (expected % 1000 == 0) {
+			pool.run(5, [&](size_t k) { batch_sum += k; });
+		}
+	}
+	producer.wait();
+	relay.wait();
+
+	CHECK(ordered);
+	CHECK(expected == items);
+	CHECK(batch_sum == (items / 97 + 1) * 21 + (items / 1000) * 10);
+}
+
+void check_batch_exception() {
+	ThreadPool pool(4);
+	std::atomic<int> ran{0};
+	bool caught = false;
+
+	try {
+		pool.run(10, [&](size_t k) {
+			++ran;
+			if (k == 3) {
+				throw std::runtime_error{"batch"};
+			}
+		});
+	} catch (const std::runtime_error &) {
+		caught = true;
+	}
+	CHECK(caught);
+	// the other tasks of the batch still ran
+	CHECK(ran == 10);
+
+	// and the pool is still usable
+	std::atomic<int> sum{0};
+	pool.run(100, [&](size_t k) { sum += static_cast<int>(k); });
+	CHECK(sum == 4950);
+}
+
+void check_batch_reuse() {
+	ThreadPool pool(4);
+	const size_t runs = 1000;
+
+	for (size_t run = 0; run < runs; ++run) {
+		std::atomic<size_t> arrived{0};
+
+		// every index waits for the others, so all helpers take part
+		pool.run(4, [&](size_t) {
+			++arrived;
+			while (arrived < 4) {
+				std::this_thread::yield();
+			}
+		});
+	}
+	// and batches the caller gets done before any worker shows up
+	for (size_t run = 0; run < runs; ++run) {
+		pool.run(8, [](size_t) {});
+	}
+	CHECK(pool.batches() == 2 * runs);
+	// a helper may still hold on to the previous batch when the next starts
+	CHECK(pool.batch_allocations() <= 10);
+}
+}
+
+int main() {
+	for (int round = 0; round < 20; ++round) {
+		check_pipeline(1 + round % 4);
+	}
+	check_batch_exception();
+	check_batch_reuse();
+	std::cout << "tasks, queues and batches: checked" << std::endl;
+
+	return test::exit_code();
+}
@@ -0,0 +1,123 @@
+// The AVX2 YUV to RGB kernels against the scalar ones (bit exact, for every
+// layout, matrix, range, width and alignment), and the scalar ones against
+// the floating point conversion
+#include "yuv_to_rgb.h"
+#include "cpu_features.h"
+#include "test.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+const YuvMatrix matrices[] = {YuvMatrix::bt601, YuvMatrix::bt709, YuvMatrix::bt2020, YuvMatrix::fcc, YuvMatrix::smpte240m};
+
+// Random samples, in range for the layout unless full_words (where the
+// kernels wrap like 16-bit lanes)
+template <YuvLayout Layout>
+void fill(std::vector<uint8_t>& bytes, test::Random& random, const bool full_words) {
+	for (size_t i = 0; i < bytes.size(); ++i) {
+		bytes[i] = static_cast<uint8_t>(random.next());
+
+		if (!full_words && Layout == YuvLayout::yuv420p10 && i % 2 == 1) {
+			bytes[i] &= 3;
+		} else if (!full_words && Layout == YuvLayout::p010 && i % 2 == 0) {
+			bytes[i] &= 0xc0;
+		}
+	}
+}
+
+template <YuvLayout Layout>
+void check_kernel(const char* name, test::Random& random) {
+	const size_t sample_bytes = Layout == YuvLayout::yuv420p10 || Layout == YuvLayout::p010 ? 2 : 1;
+	std::vector<uint8_t> y(600 * sample_bytes + 64), u(600 * sample_bytes + 64), v(600 * sample_bytes + 64);
+	std::vector<uint8_t> expected(3 * 600), actual(3 * 600);
+
+	for (int round = 0; round < 3000; ++round) {
+		const size_t width = round < 520 ? round / 2 : random.below(600);
+		// chroma of an even x, as FormatConverter passes it
+		const size_t offset = random.below(32) * 2;
+		const YuvToRgbCoefficients coefficients = yuv_to_rgb_coefficients(matrices[round % 5], round % 2 == 0);
+
+		fill<Layout>(y, random, round % 7 == 0);
+		fill<Layout>(u, random, round % 7 == 0);
+		fill<Layout>(v, random, round % 7 == 0);
+		std::fill(expected.begin(), expected.end(), 0xa5);
+		std::fill(actual.begin(), actual.end(), 0xa5);
+
+		const uint8_t* row_y = y.data() + offset * sample_bytes;
+		const uint8_t* row_u = u.data() + offset * sample_bytes;
+		const uint8_t* row_v = v.data() + offset * sample_bytes;
+
+		yuv_to_rgb_row_scalar<Layout>(row_y, row_u, row_v, expected.data(), width, coefficients);
+		yuv_to_rgb_row_avx2<Layout>(row_y, row_u, row_v, actual.data(), width, coefficients);
+
+		if (actual != expected) {
+			std::cerr << name << ": mismatch for width " << width << " at offset " << offset << std::endl;
+			CHECK(actual == expected);
+			return;
+		}
+	}
+	std::cout << name << ": checked" << std::endl;
+}
+
+// Fixed point against the exact conversion (at most one step off) of 8-bit
+// limited and full range input, over the whole cube of samples
+void check_accuracy() {
+	for (const YuvMatrix matrix : matrices) {
+		for (const bool full_range : {false, true}) {
+			const YuvToRgbCoefficients coefficients = yuv_to_rgb_coefficients(matrix, full_range);
+			const double k_r = matrix == YuvMatrix::bt709 ? 0.2126 : matrix == YuvMatrix::bt2020 ? 0.2627 :
+				matrix == YuvMatrix::fcc ? 0.30 : matrix == YuvMatrix::smpte240m ? 0.212 : 0.299;
+			const double k_b = matrix == YuvMatrix::bt709 ? 0.0722 : matrix == YuvMatrix::bt2020 ? 0.0593 :
+				matrix == YuvMatrix::fcc ? 0.11 : matrix == YuvMatrix::smpte240m ? 0.087 : 0.114;
+			const double k_g = 1.0 - k_r - k_b;
+			int max_error = 0;
+
+			for (int luma = 0; luma < 256; ++luma) {
+				for (int cb = 0; cb < 256; cb += 3) {
+					for (int cr = 0; cr < 256; cr += 5) {
+						const uint8_t y[2] = {static_cast<uint8_t>(luma), static_cast<uint8_t>(luma)};
+						const uint8_t u = static_cast<uint8_t>(cb);
+						const uint8_t v = static_cast<uint8_t>(cr);
+						uint8_t rgb[6];
+						yuv_to_rgb_row_scalar<YuvLayout::yuv420p>(y, &u, &v, rgb, 1, coefficients);
+
+						const double yf = full_range ? luma : (luma - 16) * 255.0 / 219.0;
+						const double uf = (cb - 128) * (full_range ? 1.0 : 255.0 / 224.0);
+						const double vf = (cr - 128) * (full_range ? 1.0 : 255.0 / 224.0);
+						const double exact[3] = {
+							yf + 2.0 * (1.0 - k_r) * vf,
+							yf - 2.0 * k_b * (1.0 - k_b) / k_g * uf - 2.0 * k_r * (1.0 - k_r) / k_g * vf,
+							yf + 2.0 * (1.0 - k_b) * uf};
+
+						for (int c = 0; c < 3; ++c) {
+							const int reference = static_cast<int>(std::lround(std::min(255.0, std::max(0.0, exact[c]))));
+
+							max_error = std::max(max_error, std::abs(rgb[c] - reference));
+						}
+					}
+				}
+			}
+			CHECK(max_error <= 1);
+		}
+	}
+}
+}
+
+int main() {
+	test::Random random;
+
+	check_accuracy();
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (cpu_features().avx2) {
+		check_kernel<YuvLayout::yuv420p>("AVX2 yuv420p", random);
+		check_kernel<YuvLayout::nv12>("AVX2 nv12", random);
+		check_kernel<YuvLayout::yuv420p10>("AVX2 yuv420p10le", random);
+		check_kernel<YuvLayout::p010>("AVX2 p010le", random);
+	} else {
+		std::cout << "AVX2: not supported by this CPU, skipped" << std::endl;
+	}
+#endif
+
+	return test::exit_code();
+}
@@ -0,0 +1,243 @@
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace {
+// Pool and queue of the worker running on this thread, if any
+thread_local const ThreadPool *current_pool{nullptr};
+thread_local size_t current_queue{0};
+}
+
+ThreadPool::ThreadPool(size_t threads, size_t long_running) : concurrency_{std::max<size_t>(threads, 1)} {
+	const size_t workers = concurrency_ - 1 + long_running;
+
+	queues_.reserve(workers);
+	for (size_t i = 0; i < workers; ++i) {
+		queues_.push_back(std::make_unique<Worker>());
+	}
+
+	workers_.reserve(workers);
+	for (size_t i = 0; i < workers; ++i) {
+		workers_.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	work_available_.notify_all();
+
+	for (auto &worker : workers_) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::concurrency() const {
+	return concurrency_;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	if (workers_.empty()) {
+		job();
+		return;
+	}
+
+	const size_t index = current_pool == this ? current_queue : next_queue_++ % queues_.size();
+	Worker &worker = *queues_[index];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+		pending_.fetch_add(1);
+	}
+
+	// pairs with the predicate check under mutex_ in work()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+	}
+	work_available_.notify_one();
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &task) {
+	if (concurrency_ < 2 || workers_.empty() || count < 2) {
+		for (size_t i = 0; i < count; ++i) {
+			task(i);
+		}
+		return;
+	}
+
+	// helpers that get to run after the batch is done find nothing left to
+	// take; the batch is recycled once they and the caller let go of it
+	const size_t helpers = std::min(count, concurrency_) - 1;
+	Batch *batch = acquire_batch(task, count, helpers + 1);
+
+	for (size_t i = 0; i < helpers; ++i) {
+		submit(Helper{this, batch});
+	}
+
+	while (execute(*batch)) {
+	}
+
+	std::exception_ptr exception;
+	{
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->finished.wait(lock, [batch] {
+			return batch->done == batch->count;
+		});
+		exception = batch->exception;
+	}
+	withdraw_helpers(batch);
+	release_batch(batch);
+
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+size_t ThreadPool::batch_allocations() const {
+	return batch_allocations_;
+}
+
+size_t ThreadPool::batches() const {
+	return batches_;
+}
+
+void ThreadPool::work(size_t index) {
+	current_pool = this;
+	current_queue = index;
+	trace_thread_name("worker " + std::to_string(index + 1));
+
+	for (;;) {
+		std::function<void()> job;
+
+		if (take(index, job)) {
+			job();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		work_available_.wait(lock, [this] {
+			return quit_ || pending_.load() > 0;
+		});
+
+		if (quit_) {
+			return;
+		}
+	}
+}
+
+bool ThreadPool::take(size_t index, std::function<void()> &job) {
+	// newest of its own first (still warm in the cache), then the oldest
+	// of the others
+	for (size_t i = 0; i < queues_.size(); ++i) {
+		Worker &worker = *queues_[(index + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+
+		if (!worker.jobs.empty()) {
+			if (i == 0) {
+				job = std::move(worker.jobs.back());
+				worker.jobs.pop_back();
+			} else {
+				job = std::move(worker.jobs.front());
+				worker.jobs.erase(worker.jobs.begin());
+			}
+			pending_.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+ThreadPool::Batch *ThreadPool::acquire_batch(const std::function<void(size_t)> &task, size_t count, size_t users) {
+	Batch *batch;
+	{
+		std::lock_guard<std::mutex> lock(batches_mutex_);
+
+		if (free_batches_.empty()) {
+			all_batches_.push_back(std::make_unique<Batch>());
+			free_batches_.reserve(all_batches_.size());
+			batch = all_batches_.back().get();
+			++batch_allocations_;
+		} else {
+			batch = free_batches_.back();
+			free_batches_.pop_back();
+		}
+	}
+	++batches_;
+
+	batch->task = &task;
+	batch->count = count;
+	batch->next = 0;
+	batch->done = 0;
+	batch->exception = nullptr;
+	batch->users = users;
+
+	return batch;
+}
+
+void ThreadPool::release_batch(Batch *batch) {
+	if (batch->users.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lock(batches_mutex_);
+		free_batches_.push_back(batch);
+	}
+}
+
+// Helpers that did not get to start have nothing left to do: taking them
+// back keeps them from piling up in the queues (and holding on to batches)
+// when the callers are quicker than the workers
+void ThreadPool::withdraw_helpers(Batch *batch) {
+	const auto helps = [batch](const std::function<void()> &job) {
+		const Helper *helper = job.target<Helper>();
+		return helper != nullptr && helper->batch == batch;
+	};
+	size_t withdrawn = 0;
+
+	for (auto &queue : queues_) {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		const auto end = std::remove_if(queue->jobs.begin(), queue->jobs.end(), helps);
+		const size_t removed = queue->jobs.end() - end;
+
+		if (removed > 0) {
+			queue->jobs.erase(end, queue->jobs.end());
+			pending_.fetch_sub(removed);
+			withdrawn += removed;
+		}
+	}
+
+	batch->users.fetch_sub(withdrawn);
+}
+
+void ThreadPool::Helper::operator()() const {
+	while (execute(*batch)) {
+	}
+	pool->release_batch(batch);
+}
+
+bool ThreadPool::execute(Batch &batch) {
+	const size_t index = batch.next.fetch_add(1);
+
+	if (index >= batch.count) {
+		return false;
+	}
+
+	std::exception_ptr exception;
+
+	try {
+		(*batch.task)(index);
+	} catch (...) {
+		exception = std::current_exception();
+	}
+
+	std::lock_guard<std::mutex> lock(batch.mutex);
+
+	if (exception && !batch.exception) {
+		batch.exception = exception;
+	}
+	if (++batch.done == batch.count) {
+		batch.finished.notify_all();
+	}
+
+	return true;
+}
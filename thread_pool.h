@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads shared by the whole pipeline: the demux and decode stages
+// run on it as resumable jobs (see task.h), and anyone who wants to spread a
+// piece of work over several cores (the slices of a frame conversion, the
+// rows of a difference) runs a batch on it.
+//
+// Each worker has its own queue of jobs: it takes the newest one of its own,
+// and when it has none, steals the oldest one of another worker. Jobs
+// submitted from a worker go to that worker's queue, other submissions are
+// spread round robin. Batches from different threads may run at the same
+// time; the calling thread works on its own batch too, so run() never waits
+// idle for a busy pool.
+class ThreadPool {
+public:
+	// Batches are split for threads (the caller and threads - 1 workers);
+	// long_running more workers are there for jobs that keep a thread busy
+	// for long stretches, like the pipeline stages
+	explicit ThreadPool(size_t threads, size_t long_running = 0);
+	~ThreadPool();
+
+	// Threads a batch is meant to be split for
+	size_t concurrency() const;
+
+	void submit(std::function<void()> job);
+
+	// Calls task(0) ... task(count - 1) and returns when all are done
+	// (rethrows the first exception a task threw)
+	void run(size_t count, const std::function<void(size_t)> &task);
+
+	// Batch bookkeeping is recycled, so after warm-up run() allocates nothing
+	size_t batch_allocations() const;
+	size_t batches() const;
+
+private:
+	// Only a few jobs are ever queued, so taking the oldest one from the
+	// front of a vector is cheap, and unlike a deque it keeps its storage
+	struct Worker {
+		std::mutex mutex;
+		std::vector<std::function<void()>> jobs;
+	};
+
+	// Shared by the caller of run() and its helper jobs; the last one of
+	// them to let go (users) hands it back to free_batches_
+	struct Batch {
+		const std::function<void(size_t)> *task{nullptr};
+		size_t count{0};
+		std::atomic<size_t> next{0};
+		std::mutex mutex;
+		std::condition_variable finished;
+		size_t done{0};
+		std::exception_ptr exception{};
+		std::atomic<size_t> users{0};
+	};
+
+	// Job that helps with a batch (two pointers, so std::function keeps it
+	// without an allocation)
+	struct Helper {
+		ThreadPool *pool;
+		Batch *batch;
+
+		void operator()() const;
+	};
+
+	void work(size_t index);
+	bool take(size_t index, std::function<void()> &job);
+	Batch *acquire_batch(const std::function<void(size_t)> &task, size_t count, size_t users);
+	void release_batch(Batch *batch);
+	void withdraw_helpers(Batch *batch);
+	static bool execute(Batch &batch);
+
+	const size_t concurrency_;
+	std::vector<std::unique_ptr<Worker>> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<size_t> next_queue_{0};
+	// Jobs in all queues; idle workers park until there are some
+	std::atomic<size_t> pending_{0};
+	std::mutex mutex_;
+	std::condition_variable work_available_;
+	bool quit_{false};
+
+	std::mutex batches_mutex_;
+	std::vector<std::unique_ptr<Batch>> all_batches_;
+	std::vector<Batch*> free_batches_;
+	std::atomic<size_t> batch_allocations_{0};
+	std::atomic<size_t> batches_{0};
+};
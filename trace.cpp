@@ -0,0 +1,196 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Per thread: 64k events of 40 bytes
+const size_t ring_size = 65536;
+
+struct TraceEvent {
+	const char *name;
+	int64_t begin;
+	int64_t end;
+	int64_t pts;
+	int side;
+};
+
+struct ThreadTrace {
+	explicit ThreadTrace(const int thread_id) : tid{thread_id} {
+	}
+
+	const int tid;
+	std::string name;
+	std::vector<TraceEvent> ring;
+	// Events ever recorded; the ring holds the last ring_size of them
+	uint64_t recorded{0};
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadTrace>> threads;
+	std::atomic<bool> enabled{false};
+	std::chrono::steady_clock::time_point started;
+};
+
+Registry &registry() {
+	static Registry instance;
+
+	return instance;
+}
+
+ThreadTrace &thread_trace() {
+	thread_local ThreadTrace *trace = nullptr;
+
+	if (trace == nullptr) {
+		Registry &shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+
+		shared.threads.push_back(std::make_unique<ThreadTrace>(static_cast<int>(shared.threads.size()) + 1));
+		trace = shared.threads.back().get();
+		trace->ring.resize(ring_size);
+	}
+
+	return *trace;
+}
+
+// Microseconds with the nanoseconds as fraction, as the format expects
+void write_microseconds(std::ostream &out, const int64_t nanoseconds) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%" PRId64 ".%03d", nanoseconds / 1000, static_cast<int>(nanoseconds % 1000));
+	out << buffer;
+}
+
+// Names are literals and thread names our own, so only quotes and
+// backslashes could need escaping
+std::string json_string(const std::string &value) {
+	std::string quoted = "\"";
+
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+		}
+		quoted += c;
+	}
+
+	return quoted + "\"";
+}
+}
+
+TraceSession::TraceSession(const std::string &file_name) : file_name_{file_name}, file_{file_name} {
+	if (!file_) {
+		throw std::runtime_error{"Cannot open trace file " + file_name};
+	}
+
+	Registry &shared = registry();
+	shared.started = std::chrono::steady_clock::now();
+	shared.enabled = true;
+}
+
+TraceSession::~TraceSession() {
+	registry().enabled = false;
+
+	try {
+		write();
+	} catch (const std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+}
+
+void TraceSession::write() {
+	static const char *side_names[2] = {"left", "right"};
+
+	Registry &shared = registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	uint64_t events = 0;
+	uint64_t overwritten = 0;
+
+	file_ << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl
+		<< "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"video-compare\"}}";
+
+	for (const auto &thread : shared.threads) {
+		const std::string name = thread->name.empty() ? "thread " + std::to_string(thread->tid) : thread->name;
+
+		file_ << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->tid
+			<< ",\"args\":{\"name\":" << json_string(name) << "}}";
+
+		const uint64_t first = thread->recorded > ring_size ? thread->recorded - ring_size : 0;
+
+		for (uint64_t index = first; index < thread->recorded; ++index) {
+			const TraceEvent &event = thread->ring[index % ring_size];
+
+			file_ << "," << std::endl << "{\"name\":" << json_string(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->tid;
+			if (event.side >= 0) {
+				file_ << ",\"cat\":\"" << side_names[event.side] << "\"";
+			}
+			file_ << ",\"ts\":";
+			write_microseconds(file_, event.begin);
+			file_ << ",\"dur\":";
+			write_microseconds(file_, event.end - event.begin);
+
+			if (event.side >= 0 || event.pts != INT64_MIN) {
+				file_ << ",\"args\":{";
+				if (event.side >= 0) {
+					file_ << "\"side\":\"" << side_names[event.side] << "\"" << (event.pts != INT64_MIN ? "," : "");
+				}
+				if (event.pts != INT64_MIN) {
+					file_ << "\"pts\":" << event.pts;
+				}
+				file_ << "}";
+			}
+			file_ << "}";
+		}
+
+		events += thread->recorded - first;
+		overwritten += first;
+	}
+
+	file_ << std::endl << "]}" << std::endl;
+	file_.close();
+
+	if (!file_) {
+		throw std::runtime_error{"Cannot write trace file " + file_name_};
+	}
+
+	std::cerr << "Trace: " << events << " events written to " << file_name_;
+	if (overwritten > 0) {
+		std::cerr << " (" << overwritten << " older ones overwritten)";
+	}
+	std::cerr << std::endl;
+}
+
+bool tracing() {
+	return registry().enabled.load(std::memory_order_acquire);
+}
+
+void trace_event(
+	const char *name, const int side, const int64_t pts,
+	const std::chrono::steady_clock::time_point begin,
+	const std::chrono::steady_clock::time_point end) {
+	if (!tracing()) {
+		return;
+	}
+
+	ThreadTrace &trace = thread_trace();
+	const auto started = registry().started;
+
+	// instant events may be taken in either order
+	trace.ring[trace.recorded % ring_size] = {
+		name,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(begin - started).count(),
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(begin, end) - started).count(),
+		pts, side};
+	++trace.recorded;
+}
+
+void trace_thread_name(const std::string &name) {
+	if (tracing()) {
+		thread_trace().name = name;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Pipeline events in Chrome Trace Event Format (--trace), for chrome://tracing
+// and Perfetto. Each thread appends complete events (begin and duration) to a
+// ring buffer of its own, without locks or allocations; when a thread records
+// more than fits, its oldest events are overwritten. The buffers are written
+// out once the pipeline has shut down.
+//
+// Records while alive; the destructor writes the file, so it must outlive
+// every thread that records (declare it before the pipeline)
+class TraceSession {
+public:
+	explicit TraceSession(const std::string &file_name);
+	~TraceSession();
+
+	TraceSession(const TraceSession &) = delete;
+	TraceSession &operator=(const TraceSession &) = delete;
+
+private:
+	void write();
+
+	const std::string file_name_;
+	std::ofstream file_;
+};
+
+bool tracing();
+
+// No side (-1) or pts (INT64_MIN) leaves them out; name must be a literal
+void trace_event(
+	const char *name, const int side, const int64_t pts,
+	const std::chrono::steady_clock::time_point begin,
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now());
+// Shown instead of the thread number
+void trace_thread_name(const std::string &name);
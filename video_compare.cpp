@@ -1,15 +1,24 @@
 #include "video_compare.h"
+#include "yuv_to_rgb.h"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <thread>
 #include <deque>
 extern "C" {
 	#include <libavutil/time.h>
-	#include <libavutil/imgutils.h>
 }
 
 const size_t VideoCompare::queue_size_{5};
+const size_t VideoCompare::packet_queue_depth_max_{256};
+const size_t VideoCompare::frame_queue_depth_max_{32};
+const int64_t VideoCompare::accurate_seek_tolerance_{1000};
+const size_t VideoCompare::stage_workers_{4};
+const int VideoCompare::packets_per_step_{8};
+const std::chrono::milliseconds VideoCompare::region_settle_time_{250};
+const std::chrono::milliseconds VideoCompare::scrub_window_{1000};
+const std::chrono::milliseconds VideoCompare::statistics_interval_{500};
 
 static inline bool isBehind(int64_t frame1_pts, int64_t frame2_pts) {
 	float t1 = (float) frame1_pts / 1000000.0f;
@@ -20,187 +29,738 @@ static inline bool isBehind(int64_t frame1_pts, int64_t frame2_pts) {
 	return diff < -(1.0f / 60.0f);
 }
 
-VideoCompare::VideoCompare(const std::string &left_file_name, const std::string &right_file_name) :
+// The matrix SDL's automatic YUV conversion picks for a picture height
+static YuvMatrix sdl_matrix(const int height) {
+	return height > 576 ? YuvMatrix::bt709 : YuvMatrix::bt601;
+}
+
+// SDL texture format a picture can be uploaded in as is, for the renderer to
+// convert (4:2:0 at the display size, limited range and the matrix SDL
+// picks), or RGB24 if it has to be converted (and scaled) first
+static uint32_t native_format(
+	const int format, const int frame_width, const int frame_height, const AVColorRange color_range,
+	const AVColorSpace colorspace, const size_t width, const size_t height) {
+	if (static_cast<size_t>(frame_width) == width && static_cast<size_t>(frame_height) == height &&
+		color_range != AVCOL_RANGE_JPEG && yuv_matrix(colorspace, frame_height) == sdl_matrix(frame_height)) {
+		switch (format) {
+		case AV_PIX_FMT_YUV420P:
+			return SDL_PIXELFORMAT_IYUV;
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+		case AV_PIX_FMT_NV12:
+			return SDL_PIXELFORMAT_NV12;
+#endif
+		default:
+			break;
+		}
+	}
+
+	return SDL_PIXELFORMAT_RGB24;
+}
+
+static uint32_t native_format(const AVFrame *frame, const size_t width, const size_t height) {
+	return native_format(
+		frame->format, frame->width, frame->height, frame->color_range, frame->colorspace, width, height);
+}
+
+static uint32_t native_format(const VideoDecoder &decoder, const size_t width, const size_t height) {
+	return native_format(
+		decoder.pixel_format(), decoder.width(), decoder.height(), decoder.color_range(), decoder.colorspace(),
+		width, height);
+}
+
+// Both sides as YUV textures, or both converted to RGB24, so that the two
+// pictures never differ because only one went through SDL's conversion: both
+// streams qualify, and so have the same size, range and matrix, and the same
+// format too
+static bool streams_native_yuv(const VideoDecoder &left, const VideoDecoder &right, const size_t width, const size_t height) {
+	const uint32_t format = native_format(left, width, height);
+
+	return format != SDL_PIXELFORMAT_RGB24 && format == native_format(right, width, height);
+}
+
+static bool covers(const Region &region, const SDL_Rect &area) {
+	return region.width == 0 ||
+		(area.x >= region.x && area.y >= region.y &&
+		area.x + area.w <= region.x + region.width && area.y + area.h <= region.y + region.height);
+}
+
+static size_t cores() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// By default half the cores convert, the rest is left to the decoders
+static size_t conversion_threads(const size_t configured) {
+	return configured > 0 ? configured : std::max<size_t>(1, cores() / 2);
+}
+
+// Unless configured, the cores the conversion threads leave (at least one per
+// side) are split by picture size, as the larger input has more to decode
+static int decoder_threads(
+	const VideoCompareConfig &config, AVCodecParameters *left, AVCodecParameters *right, const int video_idx) {
+	if (config.decoder_threads[video_idx] > 0) {
+		return config.decoder_threads[video_idx];
+	}
+
+	const size_t conversion = conversion_threads(config.conversion_threads);
+	const size_t available = cores() > conversion + 2 ? cores() - conversion : 2;
+	const double pixels[2] = {double(left->width) * left->height, double(right->width) * right->height};
+	const double share = (pixels[0] + pixels[1]) > 0 ? pixels[video_idx] / (pixels[0] + pixels[1]) : 0.5;
+
+	return std::max(1, static_cast<int>(std::lround(available * share)));
+}
+
+// Microseconds, or INT64_MIN if unknown (as traced)
+static int64_t to_microseconds(const int64_t timestamp, const AVRational time_base) {
+	return timestamp != AV_NOPTS_VALUE ? av_rescale_q(timestamp, time_base, {1, 1000000}) : INT64_MIN;
+}
+
+// Queued memory, for the queues' byte budgets
+static size_t packet_bytes(const std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> &packet) {
+	return packet->size;
+}
+
+static size_t frame_bytes(const Frame &frame) {
+	return frame.queued_bytes();
+}
+
+// Halvings of the video resolution that still cover the displayed resolution
+static int conversion_shift(const float resolution_scale) {
+	int shift = 0;
+
+	while (shift < 3 && resolution_scale <= 1.0f / (2 << shift)) {
+		++shift;
+	}
+
+	return shift;
+}
+
+static bool has_yuv_kernel(const VideoDecoder &decoder, const size_t width, const size_t height) {
+	return yuv_to_rgb_row(decoder.pixel_format(), AV_PIX_FMT_RGB24, decoder.width() != width || decoder.height() != height) != nullptr;
+}
+
+VideoCompare::VideoCompare(const VideoCompareConfig &config) :
 	demuxer_{
-		std::make_unique<Demuxer>(left_file_name), 
-		std::make_unique<Demuxer>(right_file_name)},
+		std::make_unique<Demuxer>(config.left_file_name, config.build_index, config.video_stream[0], config.memory_map,
+			config.read_ahead_megabytes * 1024 * 1024),
+		std::make_unique<Demuxer>(config.right_file_name, config.build_index, config.video_stream[1], config.memory_map,
+			config.read_ahead_megabytes * 1024 * 1024)},
 	video_decoder_{
-		std::make_unique<VideoDecoder>(demuxer_[0]->video_codec_parameters()), 
-		std::make_unique<VideoDecoder>(demuxer_[1]->video_codec_parameters())},
+		std::make_unique<VideoDecoder>(
+			demuxer_[0]->video_codec_parameters(),
+			decoder_threads(config, demuxer_[0]->video_codec_parameters(), demuxer_[1]->video_codec_parameters(), 0),
+			config.decoder_thread_type),
+		std::make_unique<VideoDecoder>(
+			demuxer_[1]->video_codec_parameters(),
+			decoder_threads(config, demuxer_[0]->video_codec_parameters(), demuxer_[1]->video_codec_parameters(), 1),
+			config.decoder_thread_type)},
 	max_width_{std::max(video_decoder_[0]->width(), video_decoder_[1]->width())},
 	max_height_{std::max(video_decoder_[0]->height(), video_decoder_[1]->height())},
+	yuv_kernels_{has_yuv_kernel(*video_decoder_[0], max_width_, max_height_) && has_yuv_kernel(*video_decoder_[1], max_width_, max_height_)},
+	native_yuv_{streams_native_yuv(*video_decoder_[0], *video_decoder_[1], max_width_, max_height_)},
+	thread_pool_{std::make_unique<ThreadPool>(conversion_threads(config.conversion_threads), stage_workers_)},
 	format_converter_{
-		std::make_unique<FormatConverter>(video_decoder_[0]->width(), video_decoder_[0]->height(), max_width_, max_height_, video_decoder_[0]->pixel_format(), AV_PIX_FMT_RGB24),
-		std::make_unique<FormatConverter>(video_decoder_[1]->width(), video_decoder_[1]->height(), max_width_, max_height_, video_decoder_[1]->pixel_format(), AV_PIX_FMT_RGB24)},
-	display_{std::make_unique<Display>(max_width_, max_height_, left_file_name, right_file_name)},
+		std::make_unique<FormatConverter>(video_decoder_[0]->width(), video_decoder_[0]->height(), max_width_, max_height_, video_decoder_[0]->pixel_format(), AV_PIX_FMT_RGB24, thread_pool_.get(), yuv_kernels_),
+		std::make_unique<FormatConverter>(video_decoder_[1]->width(), video_decoder_[1]->height(), max_width_, max_height_, video_decoder_[1]->pixel_format(), AV_PIX_FMT_RGB24, thread_pool_.get(), yuv_kernels_)},
+	history_converter_{
+		std::make_unique<FormatConverter>(video_decoder_[0]->width(), video_decoder_[0]->height(), max_width_, max_height_, video_decoder_[0]->pixel_format(), AV_PIX_FMT_RGB24, thread_pool_.get(), yuv_kernels_),
+		std::make_unique<FormatConverter>(video_decoder_[1]->width(), video_decoder_[1]->height(), max_width_, max_height_, video_decoder_[1]->pixel_format(), AV_PIX_FMT_RGB24, thread_pool_.get(), yuv_kernels_)},
+	display_{std::make_unique<Display>(max_width_, max_height_, config.left_file_name, config.right_file_name, thread_pool_.get())},
 	timer_{std::make_unique<Timer>()},
+	packet_pool_{
+		std::make_unique<PacketPool>(),
+		std::make_unique<PacketPool>()},
+	frame_ref_pool_{
+		std::make_unique<FrameRefPool>(),
+		std::make_unique<FrameRefPool>()},
+	frame_pool_{
+		std::make_unique<FramePool>(max_width_, max_height_, AV_PIX_FMT_RGB24),
+		std::make_unique<FramePool>(max_width_, max_height_, AV_PIX_FMT_RGB24)},
 	packet_queue_{
-		std::make_unique<PacketQueue>(queue_size_),
-		std::make_unique<PacketQueue>(queue_size_)},
+		std::make_unique<PacketQueue>(queue_size_, packet_queue_depth_max_, config.packet_queue_megabytes * 1024 * 1024, packet_bytes),
+		std::make_unique<PacketQueue>(queue_size_, packet_queue_depth_max_, config.packet_queue_megabytes * 1024 * 1024, packet_bytes)},
 	frame_queue_{
-		std::make_unique<FrameQueue>(queue_size_),
-		std::make_unique<FrameQueue>(queue_size_)} {
+		std::make_unique<FrameQueue>(queue_size_, frame_queue_depth_max_, config.frame_queue_megabytes * 1024 * 1024, frame_bytes),
+		std::make_unique<FrameQueue>(queue_size_, frame_queue_depth_max_, config.frame_queue_megabytes * 1024 * 1024, frame_bytes)},
+	accurate_seek_{config.accurate_seek},
+	history_budget_{config.history_megabytes * 1024 * 1024},
+	direct_conversion_{config.direct_conversion},
+	display_resolution_{config.display_resolution},
+	region_of_interest_{config.region_of_interest} {
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		demux_task_[video_idx] = std::make_unique<Task>(*thread_pool_, [this, video_idx] {
+			return demultiplex(video_idx);
+		});
+		decode_task_[video_idx] = std::make_unique<Task>(*thread_pool_, [this, video_idx] {
+			return decode_video(video_idx);
+		});
+
+		Task *demux = demux_task_[video_idx].get();
+		Task *decode = decode_task_[video_idx].get();
+
+		// the video thread pops frames blocking
+		packet_queue_[video_idx]->set_wake([demux] { demux->wake(); }, [decode] { decode->wake(); });
+		frame_queue_[video_idx]->set_wake([decode] { decode->wake(); }, nullptr);
+	}
 }
 
 void VideoCompare::operator()() {
-	stages_.emplace_back(&VideoCompare::thread_demultiplex_left, this);
-	stages_.emplace_back(&VideoCompare::thread_demultiplex_right, this);
-	stages_.emplace_back(&VideoCompare::thread_decode_video_left, this);
-	stages_.emplace_back(&VideoCompare::thread_decode_video_right, this);
+	print_threading();
+
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		demux_task_[video_idx]->start();
+		decode_task_[video_idx]->start();
+	}
 	video();
 
-	for (auto &stage : stages_) {
-		stage.join();
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		demux_task_[video_idx]->wait();
+		decode_task_[video_idx]->wait();
 	}
 
+	print_pool_statistics();
+	std::cerr << "Pipeline statistics:" << std::endl << pipeline_statistics();
+
 	if (exception_) {
 		std::rethrow_exception(exception_);
 	}
 }
 
-void VideoCompare::thread_demultiplex_left() {
-	demultiplex(0);
+void VideoCompare::fail(const int video_idx) {
+	exception_ = std::current_exception();
+	frame_queue_[video_idx]->quit();
+	packet_queue_[video_idx]->quit();
 }
 
-void VideoCompare::thread_demultiplex_right() {
-	demultiplex(1);
-}
+Task::Status VideoCompare::demultiplex(const int video_idx) {
+	DemuxState &state = demux_state_[video_idx];
 
-void VideoCompare::demultiplex(const int video_idx) {
 	try {
-		for (;;) {
-			if (seeking_ && readyToSeek_[1][video_idx]) {
-				readyToSeek_[0][video_idx] = true;
+		for (int packets = 0; packets < packets_per_step_; ++packets) {
+			// A packet read earlier that did not fit into the queue
+			if (state.packet) {
+				const auto push_started = std::chrono::steady_clock::now();
+				const int64_t pts = to_microseconds(state.packet->dts, demuxer_[video_idx]->time_base());
+
+				switch (packet_queue_[video_idx]->try_push(state.packet, state.epoch)) {
+				case QueueStatus::would_block:
+					return Task::Status::blocked;
+				case QueueStatus::closed:
+					return Task::Status::done;
+				case QueueStatus::done:
+					trace_event("packet push", video_idx, pts, push_started);
+					state.packet.reset();
+					break;
+				}
+			}
+
+			// Perform any seek requested by the video thread
+			if (seek_epoch_ != state.epoch) {
+				float position;
+				bool backward;
+				bool accurate;
+				{
+					std::lock_guard<std::mutex> lock(seek_mutex_);
+					state.epoch = seek_epoch_;
+					position = seek_position_;
+					backward = seek_backward_;
+					accurate = seek_accurate_;
+				}
 
-                std::chrono::milliseconds sleep(10);
-                std::this_thread::sleep_for(sleep);	
-				continue;			
+				// An accurate seek lands on the preceding keyframe and lets
+				// the decoder discard frames up to the exact target
+				const auto seek_started = std::chrono::steady_clock::now();
+				const bool seeked = demuxer_[video_idx]->seek(position, backward || accurate);
+				trace_event("demuxer seek", video_idx, static_cast<int64_t>(position * 1000000.0), seek_started);
+
+				if (!seeked && !backward) {
+					seek_failed_[video_idx] = true;
+				}
+				decode_target_[video_idx] = (seeked && accurate) ?
+					static_cast<int64_t>(position * 1000000.0) : INT64_MIN;
+			}
+			if (rewind_generation_ != state.rewind_generation) {
+				state.rewind_generation = rewind_generation_;
+				demuxer_[video_idx]->seek(0.0f, false);
 			}
 
-			// Create AVPacket
+			// Take AVPacket from pool
 			std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> packet{
-				new AVPacket,
-				[](AVPacket* p){ av_packet_unref(p); delete p; }};
-			packet->data = nullptr;
-
-			// Read frame into AVPacket
-			if (!(*demuxer_[video_idx])(*packet)) {
-				demuxer_[0]->seek(0.0f, false);
-				demuxer_[1]->seek(0.0f, false);
+				packet_pool_[video_idx]->acquire()};
+
+			// Read frame into AVPacket (loop both videos at end of file)
+			bool read;
+			{
+				StageTimer timer(Stage::demux, video_idx);
+				read = (*demuxer_[video_idx])(*packet);
+
+				if (read) {
+					timer.set_pts(to_microseconds(packet->dts, demuxer_[video_idx]->time_base()));
+				}
+			}
+			if (!read) {
+				// from the generation this side saw: when the other side has
+				// already bumped it (hit its end at the same time), both
+				// rewind for that one instead of twice
+				uint64_t seen = state.rewind_generation;
+				rewind_generation_.compare_exchange_strong(seen, seen + 1);
 				continue;
 			}
 
-			// Move into queue if first video stream
+			// Queue it (on the next round) if the selected video stream (some
+			// demuxers still return packets of discarded streams)
 			if (packet->stream_index == demuxer_[video_idx]->video_stream_index()) {
-				if (!packet_queue_[video_idx]->push(move(packet))) {
-					break;
-				}
+				state.packet = std::move(packet);
 			}
 		}
 	} catch (...) {
-		exception_ = std::current_exception();
-		frame_queue_[video_idx]->quit();
-		packet_queue_[video_idx]->quit();
+		fail(video_idx);
+		return Task::Status::done;
 	}
-}
 
-void VideoCompare::thread_decode_video_left() {
-	decode_video(0);
+	return Task::Status::progress;
 }
 
-void VideoCompare::thread_decode_video_right() {
-	decode_video(1);
-}
+QueueStatus VideoCompare::receive_frames(const int video_idx) {
+	const AVRational microseconds = {1, 1000000};
+	DecodeState &state = decode_state_[video_idx];
 
-void VideoCompare::decode_video(const int video_idx) {
-	try {
-		const AVRational microseconds = {1, 1000000};
+	// A frame decoded earlier that did not fit into the queue
+	if (state.frame.decoded) {
+		const QueueStatus status = push_frame(video_idx);
 
-		for (;;) {
-			// Create AVFrame and AVQueue
-			std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>
-				frame_decoded{
-					av_frame_alloc(), [](AVFrame* f){ av_frame_free(&f); }};
-			std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> packet{
-				nullptr, [](AVPacket* p){ av_packet_unref(p); delete p; }};
+		if (status != QueueStatus::done) {
+			return status;
+		}
+	}
 
-			// Read packet from queue
-			if (!packet_queue_[video_idx]->pop(packet)) {
-				frame_queue_[video_idx]->finished();
-				break;
+	// Whole frames decoded so far: adjust time stamps and add to queue
+	for (;;) {
+		AVFrame *frame_decoded = state.frame_decoded.get();
+
+		const auto receive_started = std::chrono::steady_clock::now();
+		const bool received = video_decoder_[video_idx]->receive(frame_decoded);
+		const auto receive_ended = std::chrono::steady_clock::now();
+		state.decode_time += receive_ended - receive_started;
+
+		if (!received) {
+			break;
+		}
+
+		// Output of a superseded seek is drained without converting
+		if (seek_epoch_ != state.epoch) {
+			continue;
+		}
+
+		frame_decoded->pts = av_rescale_q(
+			frame_decoded->pkt_dts,
+			demuxer_[video_idx]->time_base(),
+			microseconds);
+		trace_event("decode receive", video_idx, frame_decoded->pts, receive_started, receive_ended);
+
+		// Accurate seek: frames before the target are decoded but
+		// never converted (unless time stamps go backwards, i.e.
+		// the input looped before reaching the target)
+		if ((frame_decoded->pts + accurate_seek_tolerance_) < state.skip_until) {
+			if (frame_decoded->pts >= state.skipped_pts) {
+				state.skipped_pts = frame_decoded->pts;
+				++seek_skipped_frames_[video_idx];
+				continue;
 			}
+			state.skip_until = INT64_MIN;
+		}
 
-			if (seeking_) {
-				video_decoder_[video_idx]->flush();
+		// Only the time stamp is needed downstream; copying all
+		// properties would allocate side data for every frame
+		std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> frame_converted;
+		Region region;
 
-				readyToSeek_[1][video_idx] = true;
-				
-                std::chrono::milliseconds sleep(10);
-                std::this_thread::sleep_for(sleep);	
-				continue;			
+		// 4:2:0 frames are shown as YUV textures, and with direct
+		// conversion the video thread converts into the texture
+		if (!direct_conversion_ && !native_yuv(frame_decoded)) {
+			if (display_resolution_) {
+				update_converter(format_converter_[video_idx], video_idx, conversion_shift_);
 			}
 
-			// If the packet didn't send, receive more frames and try again
-			bool sent = false;
-			while (!sent && !seeking_) {
-				sent = video_decoder_[video_idx]->send(packet.get());
-
-				// If a whole frame has been decoded,
-				// adjust time stamps and add to queue
-				while (video_decoder_[video_idx]->receive(frame_decoded.get())) {
-					frame_decoded->pts = av_rescale_q(
-						frame_decoded->pkt_dts,
-						demuxer_[video_idx]->time_base(),
-						microseconds);
-
-					std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>
-						frame_converted{
-							av_frame_alloc(),
-							[](AVFrame* f){ av_free(f->data[0]); }};
-					if (av_frame_copy_props(frame_converted.get(),
-						frame_decoded.get()) < 0) {
-						throw std::runtime_error("Copying frame properties");
-					}
-					if (av_image_alloc(
-						frame_converted->data, frame_converted->linesize,
-						format_converter_[video_idx]->dest_width(), format_converter_[video_idx]->dest_height(),
-						format_converter_[video_idx]->output_pixel_format(), 1) < 0) {
-						throw std::runtime_error("Allocating picture");
-					}
-					(*format_converter_[video_idx])(
-						frame_decoded.get(), frame_converted.get());
+			// pool frames have the full size; smaller pictures use the top left
+			frame_converted = frame_pool_[video_idx]->acquire();
+			frame_converted->pts = frame_decoded->pts;
+			frame_converted->width = format_converter_[video_idx]->dest_width();
+			frame_converted->height = format_converter_[video_idx]->dest_height();
+
+			region = conversion_region(frame_decoded);
 
-					if (!frame_queue_[video_idx]->push(move(frame_converted))) {
-						break;
+			if (region.width > 0) {
+				(*format_converter_[video_idx])(
+					frame_decoded, frame_converted.get(),
+					region.x, region.y, region.width, region.height);
+			} else {
+				(*format_converter_[video_idx])(
+					frame_decoded, frame_converted.get());
+			}
+		}
+
+		// Keep the native picture too (for the history buffer)
+		Frame &frame = state.frame;
+		frame.pts = frame_decoded->pts;
+		frame.id = (++state.serial << 1) | video_idx;
+		frame.decoded = frame_ref_pool_[video_idx]->acquire();
+		av_frame_move_ref(frame.decoded.get(), frame_decoded);
+		frame.converted = std::move(frame_converted);
+		frame.converted_region = region;
+
+		const QueueStatus status = push_frame(video_idx);
+
+		if (status != QueueStatus::done) {
+			return status;
+		}
+	}
+
+	return QueueStatus::done;
+}
+
+QueueStatus VideoCompare::push_frame(const int video_idx) {
+	DecodeState &state = decode_state_[video_idx];
+	const auto push_started = std::chrono::steady_clock::now();
+	const int64_t pts = state.frame.pts;
+	const QueueStatus status = frame_queue_[video_idx]->try_push(state.frame, state.epoch);
+
+	if (status == QueueStatus::done) {
+		trace_event("frame push", video_idx, pts, push_started);
+	}
+
+	return status;
+}
+
+Task::Status VideoCompare::decode_video(const int video_idx) {
+	DecodeState &state = decode_state_[video_idx];
+	SideScope side(video_idx);
+
+	try {
+		for (int packets = 0; packets < packets_per_step_; ++packets) {
+			switch (receive_frames(video_idx)) {
+			case QueueStatus::would_block:
+				return Task::Status::blocked;
+			case QueueStatus::closed:
+				return Task::Status::done;
+			case QueueStatus::done:
+				break;
+			}
+
+			if (!state.packet) {
+				uint64_t packet_epoch;
+				const auto pop_started = std::chrono::steady_clock::now();
+
+				// Read packet from queue (packets from before a seek are dropped)
+				switch (packet_queue_[video_idx]->try_pop(state.packet, packet_epoch)) {
+				case QueueStatus::would_block:
+					return Task::Status::blocked;
+				case QueueStatus::closed:
+					frame_queue_[video_idx]->finished();
+					return Task::Status::done;
+				case QueueStatus::done:
+					trace_event("packet pop", video_idx,
+						to_microseconds(state.packet->dts, demuxer_[video_idx]->time_base()), pop_started);
+					break;
+				}
+
+				// First packet after a seek
+				if (packet_epoch != state.epoch) {
+					video_decoder_[video_idx]->flush();
+					state.epoch = packet_epoch;
+
+					state.skip_until = decode_target_[video_idx];
+					state.skipped_pts = INT64_MIN;
+					seek_skipped_frames_[video_idx] = 0;
+
+					// The thread count only changes here, where the decoder
+					// starts over anyway: reopening it in the middle of a
+					// stream would lose the references of open GOPs. The
+					// packets of a seek superseded meanwhile are dropped, and
+					// the next one sets it again.
+					bool scrubbing;
+					{
+						std::lock_guard<std::mutex> lock(seek_mutex_);
+						scrubbing = seek_scrubbing_;
 					}
+					video_decoder_[video_idx]->set_scrubbing(scrubbing);
 				}
 			}
+
+			// If the packet didn't send, receive more frames (on the next
+			// round) and try again; packets of a superseded seek are dropped
+			if (seek_epoch_ != state.epoch) {
+				state.packet.reset();
+				continue;
+			}
+
+			const auto send_started = std::chrono::steady_clock::now();
+			const bool sent = video_decoder_[video_idx]->send(state.packet.get());
+			const auto send_ended = std::chrono::steady_clock::now();
+			state.decode_time += send_ended - send_started;
+			trace_event("decode send", video_idx,
+				to_microseconds(state.packet->dts, demuxer_[video_idx]->time_base()), send_started, send_ended);
+
+			// counted per packet, with the frames received since the last one
+			if (sent) {
+				record_stage(Stage::decode, video_idx, state.decode_time);
+				state.decode_time = std::chrono::steady_clock::duration::zero();
+				state.packet.reset();
+			}
 		}
 	} catch (...) {
-		exception_ = std::current_exception();
-		frame_queue_[video_idx]->quit();
-		packet_queue_[video_idx]->quit();
+		fail(video_idx);
+		return Task::Status::done;
+	}
+
+	return Task::Status::progress;
+}
+
+uint64_t VideoCompare::request_seek(const float position, const bool backward, const bool accurate, const bool scrubbing) {
+	uint64_t epoch;
+	{
+		std::lock_guard<std::mutex> lock(seek_mutex_);
+		seek_position_ = position;
+		seek_backward_ = backward;
+		seek_accurate_ = accurate;
+		seek_scrubbing_ = scrubbing;
+		epoch = ++seek_epoch_;
+	}
+
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		packet_queue_[video_idx]->flush(epoch);
+		frame_queue_[video_idx]->flush(epoch);
+	}
+
+	return epoch;
+}
+
+// A frame that signals other properties than its stream sends both sides to
+// RGB24 from now on
+bool VideoCompare::native_yuv(const AVFrame *frame) {
+	if (native_yuv_ && native_format(frame, max_width_, max_height_) == SDL_PIXELFORMAT_RGB24) {
+		native_yuv_ = false;
+	}
+
+	return native_yuv_;
+}
+
+DisplayFrame VideoCompare::displayable(const int video_idx, Frame &frame, const bool native) {
+	DisplayFrame display_frame;
+	display_frame.id = frame.id;
+	display_frame.position = frame.pts / 1000000.0f;
+
+	AVFrame *decoded = frame.decoded.get();
+	FormatConverter *converter = history_converter_[video_idx].get();
+
+	// RGB24 on demand (subtraction mode, direct conversion)
+	display_frame.convert = [decoded, converter, video_idx](uint8_t *pixels, int pitch) {
+		SideScope side(video_idx);
+		(*converter)(decoded, pixels, pitch);
+	};
+
+	// uploaded as YUV, converted by the renderer
+	if (native) {
+		display_frame.planes = {decoded->data[0], decoded->data[1], decoded->data[2]};
+		display_frame.pitches = {static_cast<size_t>(decoded->linesize[0]), static_cast<size_t>(decoded->linesize[1]), static_cast<size_t>(decoded->linesize[2])};
+		display_frame.format = native_format(decoded, max_width_, max_height_);
+		return display_frame;
+	}
+
+	const int width = converter->dest_width();
+	const int height = converter->dest_height();
+
+	display_frame.width = width;
+	display_frame.height = height;
+
+	// converted by the display, straight into texture memory
+	if (direct_conversion_) {
+		return display_frame;
+	}
+
+	// converted at another resolution than needed now, or only partly and the
+	// view moved faster than the decode tasks could follow
+	if (frame.converted != nullptr && (frame.converted->width != width || frame.converted->height != height ||
+		!covers(frame.converted_region, display_->get_viewport().area))) {
+		frame.converted.reset();
+	}
+
+	// frames from the history buffer are converted again on demand
+	if (frame.converted == nullptr) {
+		frame.converted = frame_pool_[video_idx]->acquire();
+		frame.converted->pts = frame.pts;
+		frame.converted->width = width;
+		frame.converted->height = height;
+		frame.converted_region = Region{};
+
+		SideScope side(video_idx);
+		(*history_converter_[video_idx])(frame.decoded.get(), frame.converted.get());
+	}
+
+	AVFrame *converted = frame.converted.get();
+
+	display_frame.planes = {converted->data[0], converted->data[1], converted->data[2]};
+	display_frame.pitches = {static_cast<size_t>(converted->linesize[0]), static_cast<size_t>(converted->linesize[1]), static_cast<size_t>(converted->linesize[2])};
+	return display_frame;
+}
+
+void VideoCompare::update_converter(std::unique_ptr<FormatConverter> &converter, const int video_idx, const int shift) {
+	const size_t width = std::max<size_t>((max_width_ + (size_t(1) << shift) - 1) >> shift, 1);
+	const size_t height = std::max<size_t>((max_height_ + (size_t(1) << shift) - 1) >> shift, 1);
+
+	if (converter->dest_width() != width || converter->dest_height() != height) {
+		converter = std::make_unique<FormatConverter>(
+			video_decoder_[video_idx]->width(), video_decoder_[video_idx]->height(), width, height,
+			video_decoder_[video_idx]->pixel_format(), AV_PIX_FMT_RGB24, thread_pool_.get(), yuv_kernels_);
+	}
+}
+
+Region VideoCompare::conversion_region(const AVFrame *frame) {
+	// only unscaled pictures (zoomed in) are converted in part
+	if (!region_of_interest_ ||
+		static_cast<size_t>(frame->width) != max_width_ || static_cast<size_t>(frame->height) != max_height_ ||
+		(display_resolution_ && conversion_shift_ != 0)) {
+		return Region{};
+	}
+
+	const Viewport viewport = display_->get_viewport();
+
+	// still panning or zooming
+	if (std::chrono::steady_clock::now() - viewport.changed_at < region_settle_time_) {
+		return Region{};
+	}
+
+	const SDL_Rect &area = viewport.area;
+
+	// not worth it when most of the picture is visible anyway
+	if (size_t(area.w) * area.h * 2 > max_width_ * max_height_) {
+		return Region{};
+	}
+
+	// a quarter of the visible size on each side for panning, aligned to
+	// 4 pixels (enough for every chroma subsampling)
+	const int margin_x = std::max(64, area.w / 4);
+	const int margin_y = std::max(64, area.h / 4);
+	const int width = max_width_;
+	const int height = max_height_;
+
+	Region region;
+	region.x = std::max(0, area.x - margin_x) & ~3;
+	region.y = std::max(0, area.y - margin_y) & ~3;
+	region.width = std::min((area.x + area.w + margin_x + 3) & ~3, width) - region.x;
+	region.height = std::min((area.y + area.h + margin_y + 3) & ~3, height) - region.y;
+
+	return region;
+}
+
+// Fill level of the read-ahead buffers (whole percent, so the HUD is not
+// redrawn for every block) and how long the demuxers waited for data
+std::string VideoCompare::read_ahead_status() const {
+	const ReadAhead *read_ahead[2] = {demuxer_[0]->read_ahead(), demuxer_[1]->read_ahead()};
+
+	if (read_ahead[0] == nullptr || read_ahead[1] == nullptr) {
+		return "";
+	}
+
+	char status[96];
+	sprintf(status, "Read-ahead: %d%%/%d%% (stalled %d/%d ms)",
+		static_cast<int>(read_ahead[0]->fill() * 100.0f), static_cast<int>(read_ahead[1]->fill() * 100.0f),
+		static_cast<int>(read_ahead[0]->stalled().count()), static_cast<int>(read_ahead[1]->stalled().count()));
+
+	return status;
+}
+
+void VideoCompare::print_threading() const {
+	std::cerr << "Decoder threads: left " << video_decoder_[0]->threading()
+		<< ", right " << video_decoder_[1]->threading()
+		<< "; conversion threads: " << thread_pool_->concurrency() << std::endl;
+}
+
+// Pool misses only, see pool.h
+void VideoCompare::print_pool_statistics() const {
+	static const char* side[2] = {"Left", "Right"};
+
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		std::cerr << side[video_idx] << " pool misses: "
+			<< packet_pool_[video_idx]->allocations() << " packets allocated for "
+			<< packet_pool_[video_idx]->acquisitions() << " read, "
+			<< frame_ref_pool_[video_idx]->allocations() << " frame references allocated for "
+			<< frame_ref_pool_[video_idx]->acquisitions() << " decoded, "
+			<< frame_pool_[video_idx]->allocations() << " frames allocated for "
+			<< frame_pool_[video_idx]->acquisitions() << " converted; queue depth "
+			<< packet_queue_[video_idx]->depth() << " packets, "
+			<< frame_queue_[video_idx]->depth() << " frames" << std::endl;
+	}
+	std::cerr << "Thread pool misses: " << thread_pool_->batch_allocations() << " batches allocated for "
+		<< thread_pool_->batches() << " run" << std::endl;
+}
+
+bool VideoCompare::pop_frame(const int video_idx, Frame &frame) {
+	StageTimer timer(Stage::frame_wait, video_idx);
+
+	if (!frame_queue_[video_idx]->pop(frame)) {
+		return false;
+	}
+
+	timer.set_pts(frame.pts);
+	return true;
+}
+
+void VideoCompare::sample_queues() {
+	for (int video_idx = 0; video_idx < 2; ++video_idx) {
+		packet_occupancy_[video_idx].sample(packet_queue_[video_idx]->size(), packet_queue_[video_idx]->depth());
+		frame_occupancy_[video_idx].sample(frame_queue_[video_idx]->size(), frame_queue_[video_idx]->depth());
 	}
 }
 
+// Stage latencies, then the fill levels of the queues
+std::string VideoCompare::pipeline_statistics() const {
+	return stage_statistics() +
+		"packet queues: " + packet_occupancy_[0].summary() + " / " + packet_occupancy_[1].summary() + "\n" +
+		"frame queues: " + frame_occupancy_[0].summary() + " / " + frame_occupancy_[1].summary() + "\n";
+}
+
 void VideoCompare::video() {
+	trace_thread_name("video");
+
 	try {
-		std::deque<std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>> left_frames;
-		std::deque<std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>> right_frames;
+		// History of native frames (newest first), bounded by history_budget_
+		std::deque<Frame> left_frames;
+		std::deque<Frame> right_frames;
+		size_t history_bytes = 0;
 		int frame_offset = 0;
 
-		std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> frame_left{
-			nullptr, [](AVFrame* f){ av_frame_free(&f); }};
-		std::unique_ptr<AVFrame, std::function<void(AVFrame*)>> frame_right{
-			nullptr, [](AVFrame* f){ av_frame_free(&f); }};
+		Frame frame_left;
+		Frame frame_right;
 
 		int64_t left_pts = 0;
 		int64_t right_pts = 0;
 
+		std::string seek_timing;
+
+		// a seek within scrub_window_ of the previous one is scrubbing
+		std::chrono::steady_clock::time_point last_seek;
+		bool scrubbing = false;
+
+		// refreshed every statistics_interval_, so the HUD is not redrawn
+		// for every sample
+		std::string statistics;
+		std::chrono::steady_clock::time_point statistics_updated;
+
 		for (uint64_t frame_number = 0;; ++frame_number) {
             std::string errorMessage = "";
 
 			display_->input();
+			sample_queues();
+
+			// follow the zoom with the conversion size (both decode tasks
+			// pick it up with their next frame)
+			if (display_resolution_) {
+				const int shift = conversion_shift(display_->get_resolution_scale());
+
+				conversion_shift_ = shift;
+				update_converter(history_converter_[0], 0, shift);
+				update_converter(history_converter_[1], 1, shift);
+			}
 
 			float current_position = left_pts / 1000000.0f;
 
@@ -208,33 +768,6 @@ void VideoCompare::video() {
                 if (packet_queue_[0]->isFinished() || packet_queue_[1]->isFinished()) {
                     errorMessage = "Unable to perform seek (end of file reached)";
                 } else {
-                    seeking_ = true;
-                    readyToSeek_[0][0] = false;
-                    readyToSeek_[0][1] = false;
-                    readyToSeek_[1][0] = false;
-                    readyToSeek_[1][1] = false;
-
-                    while(true) {
-                        bool allEmpty = true;
-                        
-                        allEmpty = allEmpty && readyToSeek_[0][0];
-                        allEmpty = allEmpty && readyToSeek_[0][1];
-                        allEmpty = allEmpty && readyToSeek_[1][0];
-                        allEmpty = allEmpty && readyToSeek_[1][1];
-
-                        if (allEmpty) {
-                            break;
-                        } else {
-                            frame_queue_[0]->empty();
-                            frame_queue_[1]->empty();
-                        }
-                    }
-
-                    packet_queue_[0]->empty();
-                    packet_queue_[1]->empty();
-                    frame_queue_[0]->empty();
-                    frame_queue_[1]->empty();
-
 					auto min_duration = std::min(demuxer_[0]->duration(), demuxer_[1]->duration());
                     bool backward = display_->get_seek_relative() < 0.0f;
                     float next_position = 0;
@@ -244,30 +777,67 @@ void VideoCompare::video() {
                     } else {
                         next_position = current_position + display_->get_seek_relative();
                     }
-                    
-                    if ((!demuxer_[0]->seek(std::max(0.0f, next_position), backward) && !backward) ||
-                        (!demuxer_[1]->seek(std::max(0.0f, next_position), backward) && !backward)) {
-                        // restore position if unable to perform forward seek
+
+                    if (accurate_seek_ && (next_position * AV_TIME_BASE) >= min_duration) {
+                        // decoding forward from the last keyframe would run into the end of file
                         errorMessage = "Unable to seek past end of file";
-                        demuxer_[0]->seek(std::max(0.0f, current_position), true);
-                        demuxer_[1]->seek(std::max(0.0f, current_position), true);
-                    }
+                    } else {
+                        const auto seek_started = std::chrono::steady_clock::now();
 
-                    seeking_ = false;
+                        scrubbing = (seek_started - last_seek) < scrub_window_;
+                        last_seek = seek_started;
 
-                    frame_queue_[0]->pop(frame_left);
-                	if (frame_left != nullptr)
-	                    left_pts = frame_left->pts;
+                        request_seek(std::max(0.0f, next_position), backward, accurate_seek_, scrubbing);
 
-                    frame_queue_[1]->pop(frame_right);
-                	if (frame_right != nullptr)
-	                    right_pts = frame_right->pts;
+                        // stale frames are dropped by the queues, so the next
+                        // frames are the first ones decoded after the seek
+                        pop_frame(0, frame_left);
+                        pop_frame(1, frame_right);
 
-                    left_frames.clear();
-                    right_frames.clear();
+                        if (seek_failed_[0].exchange(false) | seek_failed_[1].exchange(false)) {
+                            // restore position if unable to perform forward seek
+                            errorMessage = "Unable to seek past end of file";
+                            request_seek(std::max(0.0f, current_position), true, accurate_seek_, scrubbing);
 
-                    current_position = frame_left->pts / 1000000.0f;
+                            pop_frame(0, frame_left);
+                            pop_frame(1, frame_right);
+                        }
+
+                        if (frame_left.decoded != nullptr)
+                            left_pts = frame_left.pts;
+                        if (frame_right.decoded != nullptr)
+                            right_pts = frame_right.pts;
+
+                        // time until both sides present the requested position
+                        const auto seek_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - seek_started).count();
+                        char seek_timing_buffer[64];
+                        if (accurate_seek_) {
+                            sprintf(seek_timing_buffer, "Seek: %d ms (skipped %d/%d)", (int) seek_milliseconds,
+                                seek_skipped_frames_[0].load(), seek_skipped_frames_[1].load());
+                        } else {
+                            sprintf(seek_timing_buffer, "Seek: %d ms", (int) seek_milliseconds);
+                        }
+                        seek_timing = seek_timing_buffer;
+                        trace_event("seek", -1, static_cast<int64_t>(std::max(0.0f, next_position) * 1000000.0), seek_started);
+
+                        left_frames.clear();
+                        right_frames.clear();
+                        history_bytes = 0;
+
+                        current_position = left_pts / 1000000.0f;
+                    }
                 }
+			} else if (scrubbing && (std::chrono::steady_clock::now() - last_seek) >= scrub_window_) {
+				scrubbing = false;
+
+				// Done scrubbing: back to all decoder threads right away, by
+				// seeking to just past the frame shown (accurately, so nothing
+				// is skipped or repeated), where the decoders start over
+				if ((video_decoder_[0]->scrubbing() || video_decoder_[1]->scrubbing()) &&
+					!packet_queue_[0]->isFinished() && !packet_queue_[1]->isFinished()) {
+					request_seek((left_pts + 2 * accurate_seek_tolerance_) / 1000000.0f, true, true, false);
+				}
 			}
 
 			bool store_frames = false;
@@ -280,22 +850,22 @@ void VideoCompare::video() {
 				if ((left_pts < 0) || isBehind(left_pts, right_pts)) {
 					adjusting = true;
 
-					frame_queue_[0]->pop(frame_left);
+					pop_frame(0, frame_left);
 				}
 				if ((right_pts < 0) || isBehind(right_pts, left_pts)) {
 					adjusting = true;
 
-					frame_queue_[1]->pop(frame_right);
+					pop_frame(1, frame_right);
 				}
 
 				if (!adjusting && display_->get_play()) {
-					if (!frame_queue_[0]->pop(frame_left) || !frame_queue_[1]->pop(frame_right)) {
+					if (!pop_frame(0, frame_left) || !pop_frame(1, frame_right)) {
 						timer_->update();
 					} else {
 						store_frames = true;
 
 						if (frame_number > 0) {
-							const int64_t frame_delay = frame_left->pts - left_pts;
+							const int64_t frame_delay = frame_left.pts - left_pts;
 							timer_->wait(frame_delay);
 						} else {
 							timer_->update();
@@ -306,67 +876,94 @@ void VideoCompare::video() {
 				}
 			}
 
-			if (frame_left != nullptr) {
-				left_pts = frame_left->pts;
+			if (frame_left.decoded != nullptr) {
+				left_pts = frame_left.pts;
 			}
-			if (frame_right != nullptr) {
-				right_pts = frame_right->pts;
+			if (frame_right.decoded != nullptr) {
+				right_pts = frame_right.pts;
 			}
 
 			if (store_frames) {
-				// TODO: use pair
-				if (left_frames.size() >= 50) {
+				history_bytes += frame_left.bytes() + frame_right.bytes();
+
+				left_frames.push_front(std::move(frame_left));
+				right_frames.push_front(std::move(frame_right));
+
+				// drop the oldest pairs once over budget (always keep the current one)
+				while (history_bytes > history_budget_ && left_frames.size() > 1 && right_frames.size() > 1) {
+					history_bytes -= left_frames.back().bytes() + right_frames.back().bytes();
+
 					left_frames.pop_back();
-				}
-				if (right_frames.size() >= 50) {
 					right_frames.pop_back();
 				}
-
-				left_frames.push_front(move(frame_left));
-				right_frames.push_front(move(frame_right));
 			} else {
-				if (frame_left != nullptr) {
+				if (frame_left.decoded != nullptr) {
+                    history_bytes += frame_left.bytes();
+
                     if (left_frames.size() > 0) {
-                        left_frames[0] = move(frame_left);
+                        history_bytes -= left_frames[0].bytes();
+                        left_frames[0] = std::move(frame_left);
                     } else {
-        				left_frames.push_front(move(frame_left));
+        				left_frames.push_front(std::move(frame_left));
                     }
 				}
-				if (frame_right != nullptr) {
+				if (frame_right.decoded != nullptr) {
+                    history_bytes += frame_right.bytes();
+
                     if (right_frames.size() > 0) {
-                        right_frames[0] = move(frame_right);
+                        history_bytes -= right_frames[0].bytes();
+                        right_frames[0] = std::move(frame_right);
                     } else {
-        				right_frames.push_front(move(frame_right));
+        				right_frames.push_front(std::move(frame_right));
                     }
 				}
 			}
 
-			frame_offset = std::min(std::max(0, frame_offset + display_->get_frame_offset_delta()), (int) left_frames.size() - 1);
-
-            char current_total_browsable[20];
-            sprintf(current_total_browsable, "%d/%d", frame_offset + 1, (int) left_frames.size());
-
-			if (!display_->get_swap_left_right()) {
-				display_->refresh(
-					{left_frames[frame_offset]->data[0], left_frames[frame_offset]->data[1], left_frames[frame_offset]->data[2]},
-					{static_cast<size_t>(left_frames[frame_offset]->linesize[0]), static_cast<size_t>(left_frames[frame_offset]->linesize[1]), static_cast<size_t>(left_frames[frame_offset]->linesize[2])},
-					{right_frames[frame_offset]->data[0], right_frames[frame_offset]->data[1], right_frames[frame_offset]->data[2]},
-					{static_cast<size_t>(right_frames[frame_offset]->linesize[0]), static_cast<size_t>(right_frames[frame_offset]->linesize[1]), static_cast<size_t>(right_frames[frame_offset]->linesize[2])},
-                    left_frames[frame_offset]->pts / 1000000.0f, 
-                    right_frames[frame_offset]->pts / 1000000.0f, 
-                    current_total_browsable,
-                    errorMessage);
-			} else {
-				display_->refresh(
-					{right_frames[frame_offset]->data[0], right_frames[frame_offset]->data[1], right_frames[frame_offset]->data[2]},
-					{static_cast<size_t>(right_frames[frame_offset]->linesize[0]), static_cast<size_t>(right_frames[frame_offset]->linesize[1]), static_cast<size_t>(right_frames[frame_offset]->linesize[2])},
-					{left_frames[frame_offset]->data[0], left_frames[frame_offset]->data[1], left_frames[frame_offset]->data[2]},
-					{static_cast<size_t>(left_frames[frame_offset]->linesize[0]), static_cast<size_t>(left_frames[frame_offset]->linesize[1]), static_cast<size_t>(left_frames[frame_offset]->linesize[2])},
-                    right_frames[frame_offset]->pts / 1000000.0f, 
-                    left_frames[frame_offset]->pts / 1000000.0f, 
-                    current_total_browsable,
-                    errorMessage);
+			const int history_size = std::min(left_frames.size(), right_frames.size());
+			frame_offset = std::min(std::max(0, frame_offset + display_->get_frame_offset_delta()), history_size - 1);
+
+			// only the displayed pair keeps its RGB conversion
+			for (int i = 0; i < history_size; ++i) {
+				if (i != frame_offset) {
+					left_frames[i].converted.reset();
+					right_frames[i].converted.reset();
+				}
 			}
+
+			// decided once for the pair (both frames checked), so the two
+			// never take different converters
+			const bool native = native_yuv(left_frames[frame_offset].decoded.get()) &
+				native_yuv(right_frames[frame_offset].decoded.get());
+			DisplayFrame left_display = displayable(0, left_frames[frame_offset], native);
+			DisplayFrame right_display = displayable(1, right_frames[frame_offset], native);
+
+            std::string status = seek_timing;
+            const std::string read_ahead = read_ahead_status();
+            if (!read_ahead.empty()) {
+                status += (status.empty() ? "" : "  ") + read_ahead;
+            }
+
+            char current_total_browsable[192];
+            if (status.empty()) {
+                sprintf(current_total_browsable, "%d/%d", frame_offset + 1, history_size);
+            } else {
+                snprintf(current_total_browsable, sizeof(current_total_browsable), "%d/%d  %s", frame_offset + 1, history_size, status.c_str());
+            }
+
+			if (!display_->get_show_statistics()) {
+				statistics.clear();
+			} else if (statistics.empty() || (std::chrono::steady_clock::now() - statistics_updated) >= statistics_interval_) {
+				statistics = pipeline_statistics();
+				statistics_updated = std::chrono::steady_clock::now();
+			}
+
+			// sides are swapped by the display itself
+			display_->refresh(
+                left_display,
+                right_display,
+                current_total_browsable,
+                errorMessage,
+                statistics);
 		}
 	} catch (...) {
 		exception_ = std::current_exception();
@@ -1,11 +1,21 @@
 #pragma once
+#include "config.h"
 #include "demuxer.h"
 #include "display.h"
 #include "format_converter.h"
+#include "frame.h"
+#include "pool.h"
 #include "queue.h"
+#include "stats.h"
+#include "task.h"
+#include "thread_pool.h"
 #include "timer.h"
 #include "video_decoder.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <thread>
@@ -18,32 +28,144 @@ extern "C"
 class VideoCompare
 {
 public:
-    VideoCompare(const std::string &left_file_name, const std::string &right_file_name);
+    VideoCompare(const VideoCompareConfig &config);
     void operator()();
 
 private:
-    void thread_demultiplex_left();
-    void thread_demultiplex_right();
-    void demultiplex(const int video_idx);
-
-    void thread_decode_video_left();
-    void thread_decode_video_right();
-    void decode_video(const int video_idx);
+    Task::Status demultiplex(const int video_idx);
+    Task::Status decode_video(const int video_idx);
+    QueueStatus receive_frames(const int video_idx);
+    QueueStatus push_frame(const int video_idx);
+    void fail(const int video_idx);
     void video();
+    bool pop_frame(const int video_idx, Frame &frame);
+    void sample_queues();
+    std::string pipeline_statistics() const;
+    uint64_t request_seek(const float position, const bool backward, const bool accurate, const bool scrubbing);
+    bool native_yuv(const AVFrame *frame);
+    DisplayFrame displayable(const int video_idx, Frame &frame, const bool native);
+    void update_converter(std::unique_ptr<FormatConverter> &converter, const int video_idx, const int shift);
+    Region conversion_region(const AVFrame *frame);
+    std::string read_ahead_status() const;
+    void print_threading() const;
+    void print_pool_statistics() const;
 
 private:
     std::unique_ptr<Demuxer> demuxer_[2];
     std::unique_ptr<VideoDecoder> video_decoder_[2];
     size_t max_width_;
     size_t max_height_;
+    // Whether the converters may use the kernels of yuv_to_rgb.h: only when
+    // both sides can, so that the two pictures never differ because one went
+    // through swscale and the other did not
+    bool yuv_kernels_;
+    // Whether frames are shown as YUV textures (see streams_native_yuv()): set when
+    // both streams qualify, and cleared for good by the first frame of either
+    // side that does not
+    std::atomic_bool native_yuv_;
+    // Runs the demux and decode tasks, and the slices of conversions and
+    // differences
+    std::unique_ptr<ThreadPool> thread_pool_;
     std::unique_ptr<FormatConverter> format_converter_[2];
+    // Used by the video thread to convert frames from the history buffer
+    std::unique_ptr<FormatConverter> history_converter_[2];
     std::unique_ptr<Display> display_;
     std::unique_ptr<Timer> timer_;
+    std::unique_ptr<PacketPool> packet_pool_[2];
+    std::unique_ptr<FrameRefPool> frame_ref_pool_[2];
+    std::unique_ptr<FramePool> frame_pool_[2];
     std::unique_ptr<PacketQueue> packet_queue_[2];
     std::unique_ptr<FrameQueue> frame_queue_[2];
-    std::vector<std::thread> stages_;
+
+    // Demux and decode run as tasks on thread_pool_, one step at a time; a
+    // step returns to the pool instead of blocking on a full or empty queue,
+    // and the queue wakes the task up again. What a stage carries over from
+    // one step to the next:
+    struct DemuxState
+    {
+        uint64_t epoch{0};
+        uint64_t rewind_generation{0};
+        // Read but not queued yet
+        std::unique_ptr<AVPacket, std::function<void(AVPacket *)>> packet;
+    };
+    struct DecodeState
+    {
+        // Reused for every decoded picture (receive() unreferences it)
+        std::unique_ptr<AVFrame, std::function<void(AVFrame *)>> frame_decoded{
+            av_frame_alloc(), [](AVFrame *f) { av_frame_free(&f); }};
+        uint64_t epoch{0};
+        uint64_t serial{0};
+        int64_t skip_until{INT64_MIN};
+        int64_t skipped_pts{INT64_MIN};
+        // Not taken by the decoder yet
+        std::unique_ptr<AVPacket, std::function<void(AVPacket *)>> packet;
+        // Decoded but not queued yet (while it has a decoded picture)
+        Frame frame;
+        // Time in the decoder since the last packet was sent
+        std::chrono::steady_clock::duration decode_time{std::chrono::steady_clock::duration::zero()};
+    };
+    DemuxState demux_state_[2];
+    DecodeState decode_state_[2];
+    std::unique_ptr<Task> demux_task_[2];
+    std::unique_ptr<Task> decode_task_[2];
+    // Pool workers for the four tasks, on top of the conversion threads
+    static const size_t stage_workers_;
+    // Packets a task handles before it goes back to the pool
+    static const int packets_per_step_;
+
+    // Initial queue depth; the queues grow up to the maximum depth while
+    // their consumer starves, within their byte budgets
     static const size_t queue_size_;
+    static const size_t packet_queue_depth_max_;
+    static const size_t frame_queue_depth_max_;
+    static const int64_t accurate_seek_tolerance_;
     std::exception_ptr exception_{};
-    volatile bool seeking_{false};
-    volatile bool readyToSeek_[2][2];
+
+    const bool accurate_seek_;
+    const size_t history_budget_;
+    const bool direct_conversion_;
+
+    // Display resolution mode: the RGB conversion size is the video size
+    // halved this many times, following the zoom (set by the video thread)
+    const bool display_resolution_;
+    std::atomic<int> conversion_shift_{0};
+
+    // Region-of-interest conversion: the decode tasks only convert the
+    // visible area plus a margin, once the viewport stayed put for a while;
+    // the video thread converts in full whatever turns out not to be covered
+    const bool region_of_interest_;
+    static const std::chrono::milliseconds region_settle_time_;
+
+    // Seek protocol: the video thread publishes a target under seek_mutex_ and
+    // bumps seek_epoch_; each demux task seeks its own demuxer and tags the
+    // following packets (and so frames) with the new epoch. Older items are
+    // dropped by the queues, and workers are woken through them.
+    std::mutex seek_mutex_;
+    float seek_position_{0.0f};
+    bool seek_backward_{false};
+    bool seek_accurate_{false};
+    bool seek_scrubbing_{false};
+    std::atomic<uint64_t> seek_epoch_{0};
+    std::atomic_bool seek_failed_[2]{{false}, {false}};
+
+    // Accurate seek: first time stamp (in microseconds) each decoder has to
+    // reach before frames are converted, and how many frames it skipped
+    std::atomic<int64_t> decode_target_[2]{{INT64_MIN}, {INT64_MIN}};
+    std::atomic<int> seek_skipped_frames_[2]{{0}, {0}};
+
+    // A seek within this time of the previous one means scrubbing: the
+    // decoders run with fewer frame threads from that seek on. Once this
+    // time has passed without another seek, the video thread seeks to where
+    // it is, which brings back all threads.
+    static const std::chrono::milliseconds scrub_window_;
+
+    // Bumped by a demux task at end of file to loop both inputs (only from
+    // the generation it has seen, so simultaneous ends rewind once)
+    std::atomic<uint64_t> rewind_generation_{0};
+
+    // Queue fill levels, sampled by the video thread once per iteration; the
+    // statistics overlay is refreshed at this interval
+    QueueOccupancy packet_occupancy_[2];
+    QueueOccupancy frame_occupancy_[2];
+    static const std::chrono::milliseconds statistics_interval_;
 };
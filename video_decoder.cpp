@@ -2,22 +2,77 @@
 #include "ffmpeg.h"
 #include <string>
 
-VideoDecoder::VideoDecoder(AVCodecParameters* codec_parameters) {
-	const auto codec = avcodec_find_decoder(codec_parameters->codec_id);
-	if (!codec) {
-		throw ffmpeg::Error{"Unsupported video codec"};
+const int VideoDecoder::scrub_thread_count_{2};
+
+static int thread_type_flags(const DecoderThreadType thread_type) {
+	switch (thread_type) {
+	case DecoderThreadType::frame:
+		return FF_THREAD_FRAME;
+	case DecoderThreadType::slice:
+		return FF_THREAD_SLICE;
+	default:
+		return FF_THREAD_FRAME | FF_THREAD_SLICE;
 	}
-	codec_context_ = avcodec_alloc_context3(codec);
-	if (!codec_context_) {
-		throw ffmpeg::Error{"Couldn't allocate video codec context"};
+}
+
+VideoDecoder::VideoDecoder(
+	AVCodecParameters* codec_parameters, const int thread_count, const DecoderThreadType thread_type) :
+	codec_parameters_{avcodec_parameters_alloc()}, thread_count_{thread_count}, thread_type_{thread_type} {
+	if (!codec_parameters_) {
+		throw ffmpeg::Error{"Couldn't allocate video codec parameters"};
+	}
+	// Kept for reopening
+	ffmpeg::check(avcodec_parameters_copy(codec_parameters_, codec_parameters));
+
+	codec_context_ = open(thread_count_);
+
+	frame_threaded_ = codec_context_->active_thread_type == FF_THREAD_FRAME;
+	active_thread_count_ = codec_context_->thread_count;
+	width_ = codec_context_->width;
+	height_ = codec_context_->height;
+	pixel_format_ = codec_context_->pix_fmt;
+	time_base_ = codec_context_->time_base;
+	color_range_ = codec_context_->color_range;
+	colorspace_ = codec_context_->colorspace;
+
+	switch (codec_context_->active_thread_type) {
+	case FF_THREAD_FRAME:
+		threading_ = "frame x" + std::to_string(codec_context_->thread_count);
+		break;
+	case FF_THREAD_SLICE:
+		threading_ = "slice x" + std::to_string(codec_context_->thread_count);
+		break;
+	default:
+		threading_ = "single threaded";
+		break;
 	}
-	ffmpeg::check(avcodec_parameters_to_context(
-		codec_context_, codec_parameters));
-	ffmpeg::check(avcodec_open2(codec_context_, codec, nullptr));
 }
 
 VideoDecoder::~VideoDecoder() {
 	avcodec_free_context(&codec_context_);
+	avcodec_parameters_free(&codec_parameters_);
+}
+
+AVCodecContext* VideoDecoder::open(const int thread_count) const {
+	const auto codec = avcodec_find_decoder(codec_parameters_->codec_id);
+	if (!codec) {
+		throw ffmpeg::Error{"Unsupported video codec"};
+	}
+	AVCodecContext* codec_context = avcodec_alloc_context3(codec);
+	if (!codec_context) {
+		throw ffmpeg::Error{"Couldn't allocate video codec context"};
+	}
+	try {
+		ffmpeg::check(avcodec_parameters_to_context(
+			codec_context, codec_parameters_));
+		codec_context->thread_count = thread_count;
+		codec_context->thread_type = thread_type_flags(thread_type_);
+		ffmpeg::check(avcodec_open2(codec_context, codec, nullptr));
+	} catch (...) {
+		avcodec_free_context(&codec_context);
+		throw;
+	}
+	return codec_context;
 }
 
 bool VideoDecoder::send(AVPacket* packet) {
@@ -44,18 +99,46 @@ void VideoDecoder::flush() {
     avcodec_flush_buffers(codec_context_);
 }
 
+void VideoDecoder::set_scrubbing(const bool scrubbing) {
+	// Slice threading adds no latency to begin with
+	if (scrubbing == scrubbing_ || !frame_threaded_ || active_thread_count_ <= scrub_thread_count_) {
+		return;
+	}
+	AVCodecContext* codec_context = open(scrubbing ? scrub_thread_count_ : thread_count_);
+
+	avcodec_free_context(&codec_context_);
+	codec_context_ = codec_context;
+	scrubbing_ = scrubbing;
+}
+
+bool VideoDecoder::scrubbing() const {
+	return scrubbing_;
+}
+
 unsigned VideoDecoder::width() const {
-	return codec_context_->width;
+	return width_;
 }
 
 unsigned VideoDecoder::height() const {
-	return codec_context_->height;
+	return height_;
 }
 
 AVPixelFormat VideoDecoder::pixel_format() const {
-	return codec_context_->pix_fmt;
+	return pixel_format_;
 }
 
 AVRational VideoDecoder::time_base() const {
-	return codec_context_->time_base;
+	return time_base_;
+}
+
+AVColorRange VideoDecoder::color_range() const {
+	return color_range_;
+}
+
+AVColorSpace VideoDecoder::colorspace() const {
+	return colorspace_;
+}
+
+std::string VideoDecoder::threading() const {
+	return threading_;
 }
@@ -1,19 +1,67 @@
 #pragma once
+#include <atomic>
+#include <string>
 extern "C" {
 	#include "libavcodec/avcodec.h"
 }
 
+// Frame threading decodes several frames at once (each thread adds a frame
+// of latency), slice threading splits a frame (needs streams coded in
+// slices or wavefronts); automatic lets libavcodec prefer frame threading
+enum class DecoderThreadType {
+	automatic,
+	frame,
+	slice
+};
+
 class VideoDecoder {
 public:
-	VideoDecoder(AVCodecParameters* codec_parameters);
+	// A thread count of 0 lets libavcodec pick one per core
+	VideoDecoder(
+		AVCodecParameters* codec_parameters,
+		int thread_count = 0, DecoderThreadType thread_type = DecoderThreadType::automatic);
 	~VideoDecoder();
+	// A null packet starts draining: receive() returns what is left
 	bool send(AVPacket* packet);
 	bool receive(AVFrame* frame);
     void flush();
+	// While scrubbing, a frame threaded decoder is reopened with at most
+	// scrub_thread_count_ threads, so fewer frames are in flight when a seek
+	// lands (other decoders are left alone). Only call this at a seek, right
+	// after flush(): the new context has none of the reference frames.
+	void set_scrubbing(bool scrubbing);
+	// Whether running with fewer threads (thread safe)
+	bool scrubbing() const;
+	// Of the stream, fixed at construction: thread safe, unlike everything
+	// else (reopening replaces the codec context under the decoding thread)
 	unsigned width() const;
 	unsigned height() const;
 	AVPixelFormat pixel_format() const;
 	AVRational time_base() const;
+	// As signalled by the stream (frames may still signal otherwise)
+	AVColorRange color_range() const;
+	AVColorSpace colorspace() const;
+	// Threading libavcodec settled on, e.g. "frame x8"
+	std::string threading() const;
 private:
+	// A fully opened context, the current one is left alone on failure
+	AVCodecContext* open(int thread_count) const;
+
+	static const int scrub_thread_count_;
+
+	AVCodecParameters* codec_parameters_{};
 	AVCodecContext* codec_context_{};
+	const int thread_count_;
+	const DecoderThreadType thread_type_;
+	// Of the regular (not scrubbing) configuration
+	bool frame_threaded_{false};
+	int active_thread_count_{1};
+	std::atomic_bool scrubbing_{false};
+	unsigned width_{0};
+	unsigned height_{0};
+	AVPixelFormat pixel_format_{AV_PIX_FMT_NONE};
+	AVRational time_base_{0, 1};
+	AVColorRange color_range_{AVCOL_RANGE_UNSPECIFIED};
+	AVColorSpace colorspace_{AVCOL_SPC_UNSPECIFIED};
+	std::string threading_;
 };
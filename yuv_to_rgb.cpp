@@ -0,0 +1,145 @@
+#include "yuv_to_rgb.h"
+#include "cpu_features.h"
+#include <cmath>
+extern "C" {
+	#include "libswscale/swscale.h"
+}
+
+namespace {
+struct LumaWeights {
+	double r;
+	double b;
+};
+
+LumaWeights luma_weights(const YuvMatrix matrix) {
+	switch (matrix) {
+	case YuvMatrix::bt709:
+		return {0.2126, 0.0722};
+	case YuvMatrix::bt2020:
+		return {0.2627, 0.0593};
+	case YuvMatrix::fcc:
+		return {0.30, 0.11};
+	case YuvMatrix::smpte240m:
+		return {0.212, 0.087};
+	default:
+		return {0.299, 0.114};
+	}
+}
+
+int16_t q13(const double value) {
+	return static_cast<int16_t>(std::lround(value * 8192.0));
+}
+
+template <YuvLayout Layout>
+YuvToRgbRowFunction best_row() {
+#if defined(__x86_64__) || defined(__i386__)
+	if (cpu_features().avx2) {
+		return yuv_to_rgb_row_avx2<Layout>;
+	}
+#endif
+	return yuv_to_rgb_row_scalar<Layout>;
+}
+
+// Same-size RGB24 conversion of an input with a hand-written kernel
+template <AVPixelFormat Input>
+YuvToRgbRowFunction same_size_rgb24_row() {
+	using Kernel = YuvToRgbKernel<Input, AV_PIX_FMT_RGB24, false>;
+	static_assert(Kernel::available, "no kernel for this format");
+
+	return best_row<Kernel::layout>();
+}
+}
+
+YuvMatrix yuv_matrix(const AVColorSpace colorspace, const int height) {
+	switch (colorspace) {
+	case AVCOL_SPC_BT709:
+		return YuvMatrix::bt709;
+	case AVCOL_SPC_BT2020_NCL:
+	case AVCOL_SPC_BT2020_CL:
+		return YuvMatrix::bt2020;
+	case AVCOL_SPC_FCC:
+		return YuvMatrix::fcc;
+	case AVCOL_SPC_SMPTE240M:
+		return YuvMatrix::smpte240m;
+	case AVCOL_SPC_BT470BG:
+	case AVCOL_SPC_SMPTE170M:
+		return YuvMatrix::bt601;
+	default:
+		return height > 576 ? YuvMatrix::bt709 : YuvMatrix::bt601;
+	}
+}
+
+int sws_colorspace(const YuvMatrix matrix) {
+	switch (matrix) {
+	case YuvMatrix::bt709:
+		return SWS_CS_ITU709;
+	case YuvMatrix::bt2020:
+		return SWS_CS_BT2020;
+	case YuvMatrix::fcc:
+		return SWS_CS_FCC;
+	case YuvMatrix::smpte240m:
+		return SWS_CS_SMPTE240M;
+	default:
+		return SWS_CS_ITU601;
+	}
+}
+
+YuvToRgbCoefficients yuv_to_rgb_coefficients(const YuvMatrix matrix, const bool full_range) {
+	const LumaWeights weights = luma_weights(matrix);
+	const double g = 1.0 - weights.r - weights.b;
+	const double y_scale = full_range ? 1.0 : 255.0 / 219.0;
+	const double c_scale = full_range ? 1.0 : 255.0 / 224.0;
+
+	YuvToRgbCoefficients coefficients;
+	coefficients.y_offset = full_range ? 0 : 16 << 6;
+	coefficients.chroma_offset = 128 << 6;
+	coefficients.y = q13(y_scale);
+	coefficients.v_r = q13(2.0 * (1.0 - weights.r) * c_scale);
+	coefficients.u_g = q13(-2.0 * weights.b * (1.0 - weights.b) / g * c_scale);
+	coefficients.v_g = q13(-2.0 * weights.r * (1.0 - weights.r) / g * c_scale);
+	coefficients.u_b = q13(2.0 * (1.0 - weights.b) * c_scale);
+
+	return coefficients;
+}
+
+template <YuvLayout Layout>
+void yuv_to_rgb_row_scalar(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, size_t width,
+	const YuvToRgbCoefficients& coefficients) {
+	for (size_t x = 0; x < width; x++) {
+		yuv_to_rgb::pixel<Layout>(y, u, v, rgb, x, coefficients);
+	}
+}
+
+template void yuv_to_rgb_row_scalar<YuvLayout::yuv420p>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_scalar<YuvLayout::nv12>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_scalar<YuvLayout::yuv420p10>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_scalar<YuvLayout::p010>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+
+YuvToRgbRowFunction yuv_to_rgb_row(const AVPixelFormat input, const AVPixelFormat output, const bool scaled) {
+	if (output != AV_PIX_FMT_RGB24 || scaled) {
+		return nullptr;
+	}
+
+	switch (input) {
+	case AV_PIX_FMT_YUV420P:
+		return same_size_rgb24_row<AV_PIX_FMT_YUV420P>();
+	case AV_PIX_FMT_NV12:
+		return same_size_rgb24_row<AV_PIX_FMT_NV12>();
+	case AV_PIX_FMT_YUV420P10LE:
+		return same_size_rgb24_row<AV_PIX_FMT_YUV420P10LE>();
+	case AV_PIX_FMT_P010LE:
+		return same_size_rgb24_row<AV_PIX_FMT_P010LE>();
+	default:
+		return nullptr;
+	}
+}
+
+const char* yuv_to_rgb_row_name() {
+#if defined(__x86_64__) || defined(__i386__)
+	if (cpu_features().avx2) {
+		return "AVX2";
+	}
+#endif
+	return "scalar";
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+	#include "libavutil/avutil.h"
+}
+
+// Same-size conversion of 4:2:0 YUV to packed RGB24 without swscale, for the
+// formats decoders usually produce. Chroma is taken from the nearest sample
+// (each chroma sample covers 2x2 luma samples).
+//
+// Fixed point: samples are normalized to 14 bits (8 bit << 6, 10 bit << 4,
+// P010 >> 2) and the offsets removed; each term is a rounding high multiply
+// with a Q13 coefficient, (a * b + 2^14) >> 15 (i.e. pmulhrsw), which leaves
+// 4 fractional bits. Terms are added with signed 16-bit saturation, then
+// rounded to 8 bits. The scalar and SIMD kernels compute exactly the same.
+enum class YuvLayout {
+	yuv420p,
+	nv12,
+	yuv420p10,
+	p010
+};
+
+enum class YuvMatrix {
+	bt601,
+	bt709,
+	bt2020,
+	fcc,
+	smpte240m
+};
+
+// Matrix of a frame; unspecified means BT.709 above 576 lines (like SDL)
+YuvMatrix yuv_matrix(const AVColorSpace colorspace, const int height);
+// For sws_getCoefficients()
+int sws_colorspace(const YuvMatrix matrix);
+
+struct YuvToRgbCoefficients {
+	// 14 bit
+	int16_t y_offset;
+	int16_t chroma_offset;
+	// Q13
+	int16_t y;
+	int16_t v_r;
+	int16_t u_g;
+	int16_t v_g;
+	int16_t u_b;
+};
+
+YuvToRgbCoefficients yuv_to_rgb_coefficients(const YuvMatrix matrix, const bool full_range);
+
+// One row: y, u and v point at the first sample of the row (v is unused for
+// the semi-planar layouts, where u points at the interleaved chroma)
+using YuvToRgbRowFunction = void (*)(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, size_t width,
+	const YuvToRgbCoefficients& coefficients);
+
+template <YuvLayout Layout>
+void yuv_to_rgb_row_scalar(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, size_t width,
+	const YuvToRgbCoefficients& coefficients);
+
+// yuv_to_rgb_avx2.cpp, only called after a CPU check
+template <YuvLayout Layout>
+void yuv_to_rgb_row_avx2(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, size_t width,
+	const YuvToRgbCoefficients& coefficients);
+
+// Which conversions have a hand-written kernel: specialized for same-size
+// RGB24 output of the supported inputs, everything else goes to swscale
+template <AVPixelFormat Input, AVPixelFormat Output, bool Scaled>
+struct YuvToRgbKernel {
+	static constexpr bool available = false;
+};
+
+template <>
+struct YuvToRgbKernel<AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB24, false> {
+	static constexpr bool available = true;
+	static constexpr YuvLayout layout = YuvLayout::yuv420p;
+};
+
+template <>
+struct YuvToRgbKernel<AV_PIX_FMT_NV12, AV_PIX_FMT_RGB24, false> {
+	static constexpr bool available = true;
+	static constexpr YuvLayout layout = YuvLayout::nv12;
+};
+
+template <>
+struct YuvToRgbKernel<AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_RGB24, false> {
+	static constexpr bool available = true;
+	static constexpr YuvLayout layout = YuvLayout::yuv420p10;
+};
+
+template <>
+struct YuvToRgbKernel<AV_PIX_FMT_P010LE, AV_PIX_FMT_RGB24, false> {
+	static constexpr bool available = true;
+	static constexpr YuvLayout layout = YuvLayout::p010;
+};
+
+// Best row function for the CPU we are running on, nullptr if swscale has
+// to do the conversion
+YuvToRgbRowFunction yuv_to_rgb_row(const AVPixelFormat input, const AVPixelFormat output, const bool scaled);
+const char* yuv_to_rgb_row_name();
+
+namespace yuv_to_rgb {
+// Scalar building blocks, shared with the tails of the SIMD kernels. Kept
+// internal to each translation unit: a shared (weak) copy compiled with
+// -mavx2 could be the one the linker keeps for the baseline code too.
+namespace {
+
+inline int16_t mulhrs(const int16_t a, const int16_t b) {
+	return static_cast<int16_t>((int32_t(a) * b + 0x4000) >> 15);
+}
+
+inline int16_t adds(const int16_t a, const int16_t b) {
+	const int32_t sum = int32_t(a) + b;
+
+	return static_cast<int16_t>(sum < -32768 ? -32768 : sum > 32767 ? 32767 : sum);
+}
+
+inline uint8_t to_byte(const int16_t value) {
+	const int16_t rounded = static_cast<int16_t>(adds(value, 8) >> 4);
+
+	return static_cast<uint8_t>(rounded < 0 ? 0 : rounded > 255 ? 255 : rounded);
+}
+
+// 14 bit samples (wrapping like the 16-bit SIMD lanes for out of range input)
+template <YuvLayout Layout>
+inline int16_t luma(const uint8_t* y, const size_t x) {
+	const uint16_t* y16 = reinterpret_cast<const uint16_t*>(y);
+
+	switch (Layout) {
+	case YuvLayout::yuv420p10:
+		return static_cast<int16_t>(static_cast<uint16_t>(y16[x] << 4));
+	case YuvLayout::p010:
+		return static_cast<int16_t>(y16[x] >> 2);
+	default:
+		return static_cast<int16_t>(y[x] << 6);
+	}
+}
+
+template <YuvLayout Layout>
+inline void chroma(const uint8_t* u, const uint8_t* v, const size_t x, int16_t& cb, int16_t& cr) {
+	const size_t c = x / 2;
+	const uint16_t* u16 = reinterpret_cast<const uint16_t*>(u);
+	const uint16_t* v16 = reinterpret_cast<const uint16_t*>(v);
+
+	switch (Layout) {
+	case YuvLayout::nv12:
+		cb = static_cast<int16_t>(u[2 * c] << 6);
+		cr = static_cast<int16_t>(u[2 * c + 1] << 6);
+		break;
+	case YuvLayout::yuv420p10:
+		cb = static_cast<int16_t>(static_cast<uint16_t>(u16[c] << 4));
+		cr = static_cast<int16_t>(static_cast<uint16_t>(v16[c] << 4));
+		break;
+	case YuvLayout::p010:
+		cb = static_cast<int16_t>(u16[2 * c] >> 2);
+		cr = static_cast<int16_t>(u16[2 * c + 1] >> 2);
+		break;
+	default:
+		cb = static_cast<int16_t>(u[c] << 6);
+		cr = static_cast<int16_t>(v[c] << 6);
+		break;
+	}
+}
+
+template <YuvLayout Layout>
+inline void pixel(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, const size_t x,
+	const YuvToRgbCoefficients& k) {
+	int16_t cb, cr;
+	chroma<Layout>(u, v, x, cb, cr);
+
+	const int16_t luma_term = mulhrs(static_cast<int16_t>(luma<Layout>(y, x) - k.y_offset), k.y);
+	cb = static_cast<int16_t>(cb - k.chroma_offset);
+	cr = static_cast<int16_t>(cr - k.chroma_offset);
+
+	rgb[3 * x] = to_byte(adds(luma_term, mulhrs(cr, k.v_r)));
+	rgb[3 * x + 1] = to_byte(adds(adds(luma_term, mulhrs(cb, k.u_g)), mulhrs(cr, k.v_g)));
+	rgb[3 * x + 2] = to_byte(adds(luma_term, mulhrs(cb, k.u_b)));
+}
+}
+}
@@ -0,0 +1,148 @@
+// Compiled with -mavx2 (see makefile); only called after a CPU check
+#include "yuv_to_rgb.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+// pshufb masks interleaving 16 R, 16 G and 16 B bytes into 48 bytes of RGB24:
+// [output block][channel] selects the channel's bytes landing in that block
+struct InterleaveMasks {
+	alignas(16) uint8_t bytes[3][3][16];
+
+	InterleaveMasks() {
+		for (int block = 0; block < 3; block++) {
+			for (int channel = 0; channel < 3; channel++) {
+				for (int i = 0; i < 16; i++) {
+					const int byte = block * 16 + i;
+
+					bytes[block][channel][i] = (byte % 3) == channel ? byte / 3 : 0x80;
+				}
+			}
+		}
+	}
+};
+
+const InterleaveMasks& interleave_masks() {
+	static const InterleaveMasks masks;
+
+	return masks;
+}
+
+// 8 16-bit values to 16 (each one twice, for two luma samples)
+inline __m256i duplicate(const __m128i values) {
+	return _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_unpacklo_epi16(values, values)), _mm_unpackhi_epi16(values, values), 1);
+}
+
+// 8 interleaved chroma pairs (u0 v0 u1 v1 ...) to 16 u and 16 v values
+inline void split(const __m256i pairs, __m256i& u, __m256i& v) {
+	u = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pairs, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+	v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pairs, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+// 16 samples normalized to 14 bits, starting at pixel x
+template <YuvLayout Layout>
+inline __m256i load_luma(const uint8_t* y, const size_t x) {
+	switch (Layout) {
+	case YuvLayout::yuv420p10:
+		return _mm256_slli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + 2 * x)), 4);
+	case YuvLayout::p010:
+		return _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + 2 * x)), 2);
+	default:
+		return _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x))), 6);
+	}
+}
+
+template <YuvLayout Layout>
+inline void load_chroma(const uint8_t* u, const uint8_t* v, const size_t x, __m256i& cb, __m256i& cr) {
+	const size_t c = x / 2;
+
+	switch (Layout) {
+	case YuvLayout::nv12:
+		split(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + 2 * c))), cb, cr);
+		cb = _mm256_slli_epi16(cb, 6);
+		cr = _mm256_slli_epi16(cr, 6);
+		break;
+	case YuvLayout::yuv420p10:
+		cb = _mm256_slli_epi16(duplicate(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + 2 * c))), 4);
+		cr = _mm256_slli_epi16(duplicate(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + 2 * c))), 4);
+		break;
+	case YuvLayout::p010:
+		split(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + 4 * c)), cb, cr);
+		cb = _mm256_srli_epi16(cb, 2);
+		cr = _mm256_srli_epi16(cr, 2);
+		break;
+	default:
+		cb = _mm256_slli_epi16(duplicate(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + c)))), 6);
+		cr = _mm256_slli_epi16(duplicate(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + c)))), 6);
+		break;
+	}
+}
+}
+
+template <YuvLayout Layout>
+void yuv_to_rgb_row_avx2(
+	const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgb, size_t width,
+	const YuvToRgbCoefficients& coefficients) {
+	const __m256i y_offset = _mm256_set1_epi16(coefficients.y_offset);
+	const __m256i chroma_offset = _mm256_set1_epi16(coefficients.chroma_offset);
+	const __m256i k_y = _mm256_set1_epi16(coefficients.y);
+	const __m256i k_v_r = _mm256_set1_epi16(coefficients.v_r);
+	const __m256i k_u_g = _mm256_set1_epi16(coefficients.u_g);
+	const __m256i k_v_g = _mm256_set1_epi16(coefficients.v_g);
+	const __m256i k_u_b = _mm256_set1_epi16(coefficients.u_b);
+	const __m256i rounding = _mm256_set1_epi16(8);
+
+	const InterleaveMasks& masks = interleave_masks();
+	__m128i mask[3][3];
+	for (int block = 0; block < 3; block++) {
+		for (int channel = 0; channel < 3; channel++) {
+			mask[block][channel] = _mm_load_si128(reinterpret_cast<const __m128i*>(masks.bytes[block][channel]));
+		}
+	}
+
+	size_t x = 0;
+
+	for (; (x + 16) <= width; x += 16) {
+		__m256i cb, cr;
+		load_chroma<Layout>(u, v, x, cb, cr);
+
+		const __m256i luma = _mm256_mulhrs_epi16(_mm256_sub_epi16(load_luma<Layout>(y, x), y_offset), k_y);
+		cb = _mm256_sub_epi16(cb, chroma_offset);
+		cr = _mm256_sub_epi16(cr, chroma_offset);
+
+		__m256i r = _mm256_adds_epi16(luma, _mm256_mulhrs_epi16(cr, k_v_r));
+		__m256i g = _mm256_adds_epi16(_mm256_adds_epi16(luma, _mm256_mulhrs_epi16(cb, k_u_g)), _mm256_mulhrs_epi16(cr, k_v_g));
+		__m256i b = _mm256_adds_epi16(luma, _mm256_mulhrs_epi16(cb, k_u_b));
+
+		r = _mm256_srai_epi16(_mm256_adds_epi16(r, rounding), 4);
+		g = _mm256_srai_epi16(_mm256_adds_epi16(g, rounding), 4);
+		b = _mm256_srai_epi16(_mm256_adds_epi16(b, rounding), 4);
+
+		// saturate to bytes: 16 R then 16 G, and 16 B
+		const __m256i rg = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, g), _MM_SHUFFLE(3, 1, 2, 0));
+		const __m256i bb = _mm256_permute4x64_epi64(_mm256_packus_epi16(b, b), _MM_SHUFFLE(3, 1, 2, 0));
+		const __m128i r8 = _mm256_castsi256_si128(rg);
+		const __m128i g8 = _mm256_extracti128_si256(rg, 1);
+		const __m128i b8 = _mm256_castsi256_si128(bb);
+
+		for (int block = 0; block < 3; block++) {
+			const __m128i out = _mm_or_si128(
+				_mm_or_si128(_mm_shuffle_epi8(r8, mask[block][0]), _mm_shuffle_epi8(g8, mask[block][1])),
+				_mm_shuffle_epi8(b8, mask[block][2]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + 3 * x + 16 * block), out);
+		}
+	}
+
+	for (; x < width; x++) {
+		yuv_to_rgb::pixel<Layout>(y, u, v, rgb, x, coefficients);
+	}
+}
+
+template void yuv_to_rgb_row_avx2<YuvLayout::yuv420p>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_avx2<YuvLayout::nv12>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_avx2<YuvLayout::yuv420p10>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+template void yuv_to_rgb_row_avx2<YuvLayout::p010>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t, const YuvToRgbCoefficients&);
+#endif